@@ -3,6 +3,7 @@
 #include <QMouseEvent>
 
 #include "QtScrcpyCoreDef.h"
+#include "videoframe.h"
 
 namespace qsc {
 
@@ -26,6 +27,10 @@ public:
         Q_UNUSED(linesizeU);
         Q_UNUSED(linesizeV);
     }
+    // same frame as onFrame(), as a refcounted handle which can be kept and
+    // used from any thread, the plane pointers of onFrame() are only valid
+    // during the call
+    virtual void onVideoFrame(const VideoFrame &frame) { Q_UNUSED(frame); }
     virtual void updateFPS(quint32 fps) { Q_UNUSED(fps); }
     virtual void grabCursor(bool grab) {Q_UNUSED(grab);}
 
@@ -123,10 +128,30 @@ public:
     virtual void installApkRequest(const QString &apkFile) = 0;
 
     virtual void screenshot() = 0;
+    // sample the decoded frames and save them from a worker thread pool,
+    // captures are dropped when saving can't keep up
+    virtual bool startCapture(const CaptureParams &params) = 0;
+    virtual void stopCapture() = 0;
+    virtual bool isCapturing() = 0;
+    // save the replay buffer (DeviceParams::replayDuration) to an mp4/mkv
+    // file from a worker thread, "": a new file in the record path
+    virtual bool saveReplay(const QString &fileName = "") = 0;
+    // record without reconnecting, "": a new file in the record path. The
+    // recording starts from the last key frame of the replay buffer when
+    // there is one, or a new key frame is requested
+    virtual bool startRecording(const QString &fileName = "") = 0;
+    // the file is finished from a worker thread
+    virtual void stopRecording() = 0;
+    virtual bool isRecording() = 0;
     virtual void showTouch(bool show) = 0;
+    // the video is not shown anywhere (window hidden, minimized or covered):
+    // only the key frames are decoded, unless frames are captured. Visible
+    // again, the encoder is reset so a key frame comes right away
+    virtual void setVideoVisible(bool visible) = 0;
 
     virtual bool isReversePort(quint16 port) = 0;
     virtual const QString &getSerial() = 0;
+    virtual DeviceStats getStats() = 0;
 
     virtual void updateScript(QString script) = 0;
     virtual bool isCurrentCustomKeymap() = 0;
@@ -32,13 +32,65 @@ struct DeviceParams {
     QString recordPath = "";          // 视频保存路径
     QString recordFileFormat = "mp4"; // 视频保存格式 mp4/mkv
     bool recordFile = false;          // 录制到文件
+    bool recordSegmented = false;     // 防崩溃录制：mp4为fragmented mp4，边录边写盘，并生成分段索引（.jsonl）
+    quint32 recordSegmentDuration = 0; // 分段录制时每段时长（秒），在关键帧处切换文件，0不限制
+    quint32 recordSegmentSize = 0;    // 分段录制时每段大小（MB），在关键帧处切换文件，0不限制
+    quint32 recordQueueSize = 0;      // 录制队列上限（MB），写入跟不上时生效，0不限制（默认，录制完整）
+    int recordQueuePolicy = 0;        // 录制队列满时 0等待写入（视频流和画面也会暂停） 1先丢弃非参考帧 2丢弃到下一个关键帧
+
+    quint32 replayDuration = 0;       // 即时回放：在内存中保留最近N秒的视频（按关键帧整段丢弃），0关闭
+    quint32 replaySize = 64;          // 即时回放缓存上限（MB）
 
     QString pushFilePath = "/sdcard/"; // 推送到安卓设备的文件保存路径（必须以/结尾）
 
     bool closeScreen = false;         // 启动时自动息屏
     bool display = true;              // 是否显示画面（或者仅仅后台录制）
     bool renderExpiredFrames = false; // 是否渲染延迟视频帧
+    int decoderThreadMode = 0;        // 解码多线程模式 0自动（按分辨率和CPU核数选择） 1slice多线程（低延迟） 2frame多线程（高吞吐，有延迟）
+    int decoderThreads = 0;           // 解码线程数 0自动
+    QString screenshotFormat = "png"; // 截图格式 png/jpg/webp（jpg直接由YUV编码，速度最快）
+    int screenshotQuality = 90;       // 截图质量 1-100（jpg/webp）
     QString gameScript = "";          // 游戏映射脚本
 };
+
+struct CaptureParams {
+    enum Mode {
+        MODE_INTERVAL = 0,            // 按时间间隔采样
+        MODE_EVERY_NTH_FRAME,         // 每N帧采样一次
+        MODE_SCENE_CHANGE,            // 画面变化时采样
+    };
+    int mode = MODE_INTERVAL;         // 采样方式
+    quint32 intervalMs = 1000;        // 采样间隔（毫秒），MODE_INTERVAL
+    quint32 everyNthFrame = 30;       // 每N帧采样一次，MODE_EVERY_NTH_FRAME
+    int sceneThreshold = 10;          // 画面变化阈值（亮度平均差 1-255），MODE_SCENE_CHANGE
+    QString savePath = "";            // 保存目录，""表示使用recordPath
+    QString format = "jpg";           // 截图格式 png/jpg/webp
+    int quality = 90;                 // 截图质量 1-100（jpg/webp）
+    int maxPending = 8;               // 最多同时保存的截图数，超出时丢弃（不会阻塞视频）
+    int threads = 0;                  // 保存线程数 0自动
+};
+
+struct DeviceStats {
+    // 视频包内存池
+    quint64 packetPoolHits = 0;       // 复用池中缓冲区的次数
+    quint64 packetPoolMisses = 0;     // 池中无空闲缓冲区需要新分配的次数
+
+    // 解码线程
+    quint32 decoderQueueDepth = 0;    // 当前待解码包数
+    quint32 decoderQueuePeak = 0;     // 待解码包数峰值
+    quint64 decoderDroppedPackets = 0; // 解码跟不上时丢弃的包数（丢到下一个关键帧）
+    quint64 decoderSkippedPackets = 0; // 视频不可见时跳过的非关键帧包数
+
+    // 录制队列
+    quint64 recorderQueueBytes = 0;     // 当前待写入字节数
+    quint64 recorderQueuePeakBytes = 0; // 待写入字节数峰值
+    quint32 recorderQueuePeak = 0;      // 待写入包数峰值
+    quint64 recorderDroppedPackets = 0; // 队列满时丢弃的包数
+
+    // 连续截图
+    quint64 captureFrames = 0;        // 已保存的截图数
+    quint64 captureDropped = 0;       // 保存跟不上（或保存失败）时丢弃的截图数
+    quint32 capturePending = 0;       // 当前正在保存的截图数
+};
     
 }
@@ -0,0 +1,46 @@
+#ifndef VIDEOFRAME_H
+#define VIDEOFRAME_H
+
+#include <QMetaType>
+#include <QSharedPointer>
+
+// forward declarations
+typedef struct AVFrame AVFrame;
+
+namespace qsc {
+
+// Immutable, refcounted handle on a decoded YUV420P frame.
+// Copying a handle only takes a new reference on the same picture, which is
+// released with the last handle, so frames can be kept and processed on any
+// thread without copying the planes and without holding the decoder.
+class VideoFrame
+{
+public:
+    VideoFrame();
+    // takes a new reference on the buffers of frame (no copy)
+    explicit VideoFrame(const AVFrame *frame, qint64 decodedTimeUs = 0);
+
+    bool isNull() const;
+    int width() const;
+    int height() const;
+    // plane 0: Y, 1: U, 2: V
+    const uint8_t *data(int plane) const;
+    int linesize(int plane) const;
+    qint64 pts() const;
+    // when the decoder output the frame, on the currentTimeUs() clock, 0 if unknown
+    qint64 decodedTimeUs() const;
+    // monotonic clock in microseconds, to measure the latency after decoding
+    static qint64 currentTimeUs();
+
+    const AVFrame *avFrame() const;
+
+private:
+    QSharedPointer<AVFrame> m_frame;
+    qint64 m_decodedTimeUs = 0;
+};
+
+}
+
+Q_DECLARE_METATYPE(qsc::VideoFrame)
+
+#endif // VIDEOFRAME_H
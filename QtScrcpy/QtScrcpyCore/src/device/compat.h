@@ -2,6 +2,7 @@
 #define COMPAT_H
 #include "libavcodec/version.h"
 #include "libavformat/version.h"
+#include "libavutil/version.h"
 
 // In ffmpeg/doc/APIchanges:
 // 2016-04-11 - 6f69f7a / 9200514 - lavf 57.33.100 / 57.5.0 - avformat.h
@@ -32,4 +33,13 @@
 #define QTSCRCPY_LAVF_HAS_NEW_ENCODING_DECODING_API
 #endif
 
+// In ffmpeg/doc/APIchanges:
+// 2021-03-10 - lavu 56.69.100 - buffer.h
+//   Change AVBufferRef related AVBuffer API size parameters to size_t,
+//   effective with the lavu 57 major bump.
+//   (the AVPacket side data size parameters follow the same switch)
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+#define QTSCRCPY_LAVU_HAS_SIZE_T_BUFFER_API
+#endif
+
 #endif // COMPAT_H
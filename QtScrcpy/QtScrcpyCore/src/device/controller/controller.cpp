@@ -200,6 +200,15 @@ void Controller::setDisplayPower(bool on)
     postControlMsg(controlMsg);
 }
 
+void Controller::resetVideo()
+{
+    ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_RESET_VIDEO);
+    if (!controlMsg) {
+        return;
+    }
+    postControlMsg(controlMsg);
+}
+
 void Controller::mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize)
 {
     if (m_inputConvert) {
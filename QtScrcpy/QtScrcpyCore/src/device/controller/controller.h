@@ -37,6 +37,8 @@ public:
     void expandNotificationPanel();
     void collapsePanel();
     void setDisplayPower(bool on);
+    // the encoder restarts, the next packet is a key frame
+    void resetVideo();
 
     // for input convert
     void mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize);
@@ -4,8 +4,11 @@
 #include "decoder.h"
 #include "videobuffer.h"
 
+// a few frames of slack, more is only latency
+#define MAX_QUEUE_SIZE 8
+
 Decoder::Decoder(std::function<void(int, int, uint8_t*, uint8_t*, uint8_t*, int, int, int)> onFrame, QObject *parent)
-    : QObject(parent)
+    : QThread(parent)
     , m_vb(new VideoBuffer())
     , m_onFrame(onFrame)
 {
@@ -19,6 +22,17 @@ Decoder::~Decoder() {
     delete m_vb;
 }
 
+void Decoder::setFrameSize(const QSize &frameSize)
+{
+    m_frameSize = frameSize;
+}
+
+void Decoder::setThreadMode(ThreadMode mode, int threadCount)
+{
+    m_threadMode = mode;
+    m_threadCount = threadCount;
+}
+
 bool Decoder::open()
 {
     // codec
@@ -34,11 +48,45 @@ bool Decoder::open()
         qCritical("Could not allocate decoder context");
         return false;
     }
+
+    // threading
+    ThreadMode threadMode = m_threadMode;
+    if (THREAD_MODE_AUTO == threadMode) {
+        // the device encoders usually produce a single slice per frame, so
+        // slice threading only pays off with multi-slice streams: large
+        // streams need frame threading to keep up, at the cost of latency
+        bool largeFrame = m_frameSize.width() * m_frameSize.height() > 1920 * 1080;
+        threadMode = largeFrame && QThread::idealThreadCount() >= 4 ? THREAD_MODE_FRAME : THREAD_MODE_SLICE;
+    }
+    int threadCount = m_threadCount;
+    if (threadMode == THREAD_MODE_FRAME) {
+        // each frame thread delays the output by one frame
+        if (threadCount <= 0) {
+            threadCount = qMin(QThread::idealThreadCount(), 4);
+        }
+        m_codecCtx->thread_type = FF_THREAD_FRAME;
+    } else {
+        // slice threading does not delay the output
+        m_codecCtx->thread_type = FF_THREAD_SLICE;
+        m_codecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
+    // 0 lets FFmpeg pick the number of cores
+    m_codecCtx->thread_count = qMax(threadCount, 0);
+    m_codecCtx->width = m_frameSize.width();
+    m_codecCtx->height = m_frameSize.height();
+
     if (avcodec_open2(m_codecCtx, codec, NULL) < 0) {
         qCritical("Could not open H.264 codec");
         return false;
     }
     m_isCodecCtxOpen = true;
+    const char *activeThreadType = "none";
+    if (m_codecCtx->active_thread_type == FF_THREAD_FRAME) {
+        activeThreadType = "frame";
+    } else if (m_codecCtx->active_thread_type == FF_THREAD_SLICE) {
+        activeThreadType = "slice";
+    }
+    qInfo("Decoder opened: %s threading, %d threads", activeThreadType, m_codecCtx->thread_count);
     return true;
 }
 
@@ -57,7 +105,244 @@ void Decoder::close()
     avcodec_free_context(&m_codecCtx);
 }
 
+bool Decoder::startDecoder()
+{
+    if (!m_codecCtx) {
+        return false;
+    }
+    m_stopped = false;
+    start();
+    return true;
+}
+
+void Decoder::stopDecoder()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopped = true;
+        m_recvDataCond.wakeOne();
+    }
+    // the decoder thread may wait for the previous frame to be rendered
+    if (m_vb) {
+        m_vb->interrupt();
+    }
+    wait();
+    queueClear();
+}
+
 bool Decoder::push(const AVPacket *packet)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_stopped || !m_codecCtx) {
+        return false;
+    }
+
+    bool isKeyFrame = packet->flags & AV_PKT_FLAG_KEY;
+    if (m_keyFramesOnly && !isKeyFrame) {
+        keepConfig(packet);
+        m_skippedPackets++;
+        return true;
+    }
+    if (m_waitKeyFrame) {
+        if (!isKeyFrame) {
+            keepConfig(packet);
+            m_droppedPackets++;
+            return true;
+        }
+        m_waitKeyFrame = false;
+    }
+
+    if (m_queue.size() >= MAX_QUEUE_SIZE) {
+        // the decoder cannot keep up: never block the demuxer (and the
+        // network), drop the frames no other frame depends on first
+        int dropped = dropNonRef();
+        if (!dropped) {
+            // every queued frame is referenced: drop them all and ask the
+            // device for a key frame instead of waiting for the next one
+            qWarning("Decoder queue overflow, %d packets dropped", static_cast<int>(m_queue.size()));
+            while (!m_queue.isEmpty()) {
+                AVPacket *queued = m_queue.dequeue();
+                keepConfig(queued);
+                packetDelete(queued);
+                m_droppedPackets++;
+            }
+            if (!isKeyFrame) {
+                keepConfig(packet);
+                m_droppedPackets++;
+                m_waitKeyFrame = true;
+                locker.unlock();
+                emit keyFrameRequested();
+                return true;
+            }
+        } else {
+            qWarning("Decoder queue overflow, %d non-reference packets dropped", dropped);
+        }
+    }
+
+    AVPacket *dec = packetNew(packet);
+    if (!dec) {
+        return false;
+    }
+    if (!m_droppedConfig.isEmpty() && !av_packet_get_side_data(dec, AV_PKT_DATA_NEW_EXTRADATA, Q_NULLPTR)) {
+        quint8 *extradata = av_packet_new_side_data(dec, AV_PKT_DATA_NEW_EXTRADATA, m_droppedConfig.size());
+        if (extradata) {
+            memcpy(extradata, m_droppedConfig.constData(), static_cast<size_t>(m_droppedConfig.size()));
+        }
+    }
+    m_droppedConfig.clear();
+
+    m_queue.enqueue(dec);
+    m_queuePeak = qMax(m_queuePeak, static_cast<quint32>(m_queue.size()));
+    m_recvDataCond.wakeOne();
+    return true;
+}
+
+void Decoder::setKeyFramesOnly(bool keyFramesOnly)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_keyFramesOnly == keyFramesOnly) {
+        return;
+    }
+    m_keyFramesOnly = keyFramesOnly;
+    if (!keyFramesOnly) {
+        // the next non key frames reference the skipped ones
+        m_waitKeyFrame = true;
+    }
+}
+
+quint32 Decoder::queueDepth()
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<quint32>(m_queue.size());
+}
+
+quint32 Decoder::queuePeak()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queuePeak;
+}
+
+quint64 Decoder::droppedPackets()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_droppedPackets;
+}
+
+quint64 Decoder::skippedPackets()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_skippedPackets;
+}
+
+void Decoder::run()
+{
+    for (;;) {
+        AVPacket *packet = Q_NULLPTR;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_stopped && m_queue.isEmpty()) {
+                m_recvDataCond.wait(&m_mutex);
+            }
+            if (m_stopped) {
+                break;
+            }
+            packet = m_queue.dequeue();
+        }
+
+        bool ok = decode(packet);
+        packetDelete(packet);
+        if (!ok) {
+            qCritical("Could not decode packet");
+        }
+    }
+}
+
+AVPacket *Decoder::packetNew(const AVPacket *packet)
+{
+    AVPacket *dec = av_packet_alloc();
+    if (!dec) {
+        return Q_NULLPTR;
+    }
+
+    // the payload is refcounted, no copy here
+    if (av_packet_ref(dec, packet)) {
+        av_packet_free(&dec);
+        return Q_NULLPTR;
+    }
+    return dec;
+}
+
+void Decoder::packetDelete(AVPacket *packet)
+{
+    av_packet_unref(packet);
+    av_packet_free(&packet);
+}
+
+void Decoder::keepConfig(const AVPacket *packet)
+{
+    // a config must survive the packet carrying it, the next key frame
+    // may depend on it
+#ifdef QTSCRCPY_LAVU_HAS_SIZE_T_BUFFER_API
+    size_t configSize = 0;
+#else
+    int configSize = 0;
+#endif
+    quint8 *config = av_packet_get_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA, &configSize);
+    if (config && configSize > 0) {
+        m_droppedConfig = QByteArray(reinterpret_cast<const char *>(config), static_cast<int>(configSize));
+    }
+}
+
+bool Decoder::isNonRef(const AVPacket *packet)
+{
+    if (packet->flags & AV_PKT_FLAG_KEY) {
+        return false;
+    }
+    // H.264 annex B: nal_ref_idc of the first slice
+    const quint8 *data = packet->data;
+    for (int i = 0; i + 3 < packet->size; i++) {
+        if (data[i] || data[i + 1] || data[i + 2] != 1) {
+            continue;
+        }
+        quint8 header = data[i + 3];
+        int type = header & 0x1f;
+        if (type == 1 || type == 5) {
+            return !(header & 0x60);
+        }
+        i += 2;
+    }
+    return false;
+}
+
+int Decoder::dropNonRef()
+{
+    int dropped = 0;
+    for (int i = 0; i < m_queue.size();) {
+        AVPacket *packet = m_queue.at(i);
+        if (!isNonRef(packet)) {
+            i++;
+            continue;
+        }
+        m_queue.removeAt(i);
+        keepConfig(packet);
+        packetDelete(packet);
+        m_droppedPackets++;
+        dropped++;
+    }
+    return dropped;
+}
+
+void Decoder::queueClear()
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_queue.isEmpty()) {
+        packetDelete(m_queue.dequeue());
+    }
+    m_droppedConfig.clear();
+    m_waitKeyFrame = false;
+}
+
+bool Decoder::decode(const AVPacket *packet)
 {
     if (!m_codecCtx || !m_vb) {
         return false;
@@ -71,12 +356,11 @@ bool Decoder::push(const AVPacket *packet)
         qCritical("Could not send video packet: %s", errorbuf);
         return false;
     }
-    if (decodingFrame) {
-        ret = avcodec_receive_frame(m_codecCtx, decodingFrame);
-    }
-    if (!ret) {
+    // with frame threading, one packet may release several frames
+    while (decodingFrame && !(ret = avcodec_receive_frame(m_codecCtx, decodingFrame))) {
         // a frame was received
         pushFrame();
+        decodingFrame = m_vb->decodingFrame();
 
         //emit getOneFrame(yuvDecoderFrame->data[0], yuvDecoderFrame->data[1], yuvDecoderFrame->data[2],
         //        yuvDecoderFrame->linesize[0], yuvDecoderFrame->linesize[1], yuvDecoderFrame->linesize[2]);
@@ -99,7 +383,8 @@ bool Decoder::push(const AVPacket *packet)
         //QImage image = tmpImg.copy();
         //emit getOneImage(image);
         */
-    } else if (ret != AVERROR(EAGAIN)) {
+    }
+    if (ret && ret != AVERROR(EAGAIN)) {
         qCritical("Could not receive video frame: %d", ret);
         return false;
     }
@@ -120,12 +405,22 @@ bool Decoder::push(const AVPacket *packet)
     return true;
 }
 
-void Decoder::peekFrame(std::function<void (int, int, uint8_t *)> onFrame)
+void Decoder::setOnVideoFrame(std::function<void(const qsc::VideoFrame &)> onVideoFrame)
+{
+    m_onVideoFrame = onVideoFrame;
+}
+
+void Decoder::setOnDecodedFrame(std::function<void(const AVFrame *)> onDecodedFrame)
+{
+    m_onDecodedFrame = onDecodedFrame;
+}
+
+qsc::VideoFrame Decoder::peekFrame()
 {
     if (!m_vb) {
-        return;
+        return qsc::VideoFrame();
     }
-    m_vb->peekRenderedFrame(onFrame);
+    return m_vb->peekRenderedFrame();
 }
 
 void Decoder::pushFrame()
@@ -133,6 +428,10 @@ void Decoder::pushFrame()
     if (!m_vb) {
         return;
     }
+    if (m_onDecodedFrame) {
+        // before the frame is handed to the renderer, which may skip it
+        m_onDecodedFrame(m_vb->decodingFrame());
+    }
     bool previousFrameSkipped = true;
     m_vb->offerDecodedFrame(previousFrameSkipped);
     if (previousFrameSkipped) {
@@ -147,8 +446,18 @@ void Decoder::onNewFrame() {
         return;
     }
 
+    // the decoder keeps decoding into its own frame meanwhile, the lock only
+    // guards the rendering frame against peekFrame()
     m_vb->lock();
     const AVFrame *frame = m_vb->consumeRenderedFrame();
-    m_onFrame(frame->width, frame->height, frame->data[0], frame->data[1], frame->data[2], frame->linesize[0], frame->linesize[1], frame->linesize[2]);
+    if (frame) {
+        m_onFrame(frame->width, frame->height, frame->data[0], frame->data[1], frame->data[2], frame->linesize[0], frame->linesize[1], frame->linesize[2]);
+    }
+    // the handle only references the frame buffers, no copy
+    qsc::VideoFrame videoFrame(frame, m_vb->renderedFrameDecodedTimeUs());
     m_vb->unLock();
+
+    if (m_onVideoFrame && !videoFrame.isNull()) {
+        m_onVideoFrame(videoFrame);
+    }
 }
@@ -1,6 +1,11 @@
 #ifndef DECODER_H
 #define DECODER_H
-#include <QObject>
+#include <QByteArray>
+#include <QMutex>
+#include <QQueue>
+#include <QSize>
+#include <QThread>
+#include <QWaitCondition>
 
 extern "C"
 {
@@ -9,21 +14,51 @@ extern "C"
 
 #include <functional>
 
+#include "videoframe.h"
+
 class VideoBuffer;
-class Decoder : public QObject
+class Decoder : public QThread
 {
     Q_OBJECT
 public:
+    enum ThreadMode
+    {
+        THREAD_MODE_AUTO = 0,
+        THREAD_MODE_SLICE, // lowest latency
+        THREAD_MODE_FRAME, // highest throughput
+    };
+
     Decoder(std::function<void(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV)> onFrame, QObject *parent = Q_NULLPTR);
     virtual ~Decoder();
 
+    void setFrameSize(const QSize &frameSize);
+    // must be called before open()
+    void setThreadMode(Decoder::ThreadMode mode, int threadCount);
     bool open();
     void close();
+    bool startDecoder();
+    void stopDecoder();
+    // called from the demuxer thread, the packet is decoded on the decoder thread
     bool push(const AVPacket *packet);
-    void peekFrame(std::function<void(int width, int height, uint8_t* dataRGB32)> onFrame);
+    // nobody looks at the frames: the non key frames are dropped before being
+    // queued, back to normal from the next key frame once disabled
+    void setKeyFramesOnly(bool keyFramesOnly);
+    // called on the rendering thread with each rendered frame, as a refcounted handle
+    void setOnVideoFrame(std::function<void(const qsc::VideoFrame &frame)> onVideoFrame);
+    // called on the decoder thread with every decoded frame, even the ones
+    // the renderer skips; the frame is only valid during the call
+    void setOnDecodedFrame(std::function<void(const AVFrame *frame)> onDecodedFrame);
+    qsc::VideoFrame peekFrame();
+
+    quint32 queueDepth();
+    quint32 queuePeak();
+    quint64 droppedPackets();
+    quint64 skippedPackets();
 
 signals:
     void updateFPS(quint32 fps);
+    // the queued frames were dropped, the decoder waits for a key frame
+    void keyFrameRequested();
 
 private slots:
     void onNewFrame();
@@ -31,14 +66,45 @@ private slots:
 signals:
     void newFrame();
 
+protected:
+    void run();
+
 private:
+    bool decode(const AVPacket *packet);
     void pushFrame();
+    AVPacket *packetNew(const AVPacket *packet);
+    void packetDelete(AVPacket *packet);
+    void keepConfig(const AVPacket *packet);
+    static bool isNonRef(const AVPacket *packet);
+    // drop the queued frames no other frame references, returns their count
+    int dropNonRef();
+    void queueClear();
 
 private:
     VideoBuffer *m_vb = Q_NULLPTR;
     AVCodecContext *m_codecCtx = Q_NULLPTR;
     bool m_isCodecCtxOpen = false;
+    QSize m_frameSize;
+    ThreadMode m_threadMode = THREAD_MODE_AUTO;
+    int m_threadCount = 0; // 0: auto
+
+    QMutex m_mutex;
+    QWaitCondition m_recvDataCond;
+    bool m_stopped = false;      // set on stopDecoder()
+    // when the queue overflows with referenced frames only, the queued
+    // packets are dropped and the following packets too, until a key frame
+    // (they could not be decoded)
+    bool m_waitKeyFrame = false;
+    // config carried by a dropped packet, attached to the next queued one
+    QByteArray m_droppedConfig;
+    QQueue<AVPacket *> m_queue;
+    quint32 m_queuePeak = 0;
+    quint64 m_droppedPackets = 0;
+    bool m_keyFramesOnly = false;
+    quint64 m_skippedPackets = 0;
     std::function<void(int, int, uint8_t*, uint8_t*, uint8_t*, int, int, int)> m_onFrame = Q_NULLPTR;
+    std::function<void(const qsc::VideoFrame &)> m_onVideoFrame = Q_NULLPTR;
+    std::function<void(const AVFrame *)> m_onDecodedFrame = Q_NULLPTR;
 };
 
 #endif // DECODER_H
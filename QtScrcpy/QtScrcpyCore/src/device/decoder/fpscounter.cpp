@@ -21,7 +21,7 @@ void FpsCounter::stop()
 
 bool FpsCounter::isStarted()
 {
-    return m_counterTimer;
+    return m_counterTimer != 0;
 }
 
 void FpsCounter::addRenderedFrame()
@@ -37,9 +37,8 @@ void FpsCounter::addSkippedFrame()
 void FpsCounter::timerEvent(QTimerEvent *event)
 {
     if (event && m_counterTimer == event->timerId()) {
-        m_curRendered = m_rendered;
-        m_curSkipped = m_skipped;
-        resetCounter();
+        m_curRendered = m_rendered.exchange(0);
+        m_curSkipped = m_skipped.exchange(0);
         emit updateFPS(m_curRendered);
         //qInfo("FPS:%d Discard:%d", m_curRendered, m_skipped);
     }
@@ -2,6 +2,8 @@
 #define FPSCOUNTER_H
 #include <QObject>
 
+#include <atomic>
+
 class FpsCounter : public QObject
 {
     Q_OBJECT
@@ -11,6 +13,7 @@ public:
 
     void start();
     void stop();
+    // may be called from any thread
     bool isStarted();
     void addRenderedFrame();
     void addSkippedFrame();
@@ -27,12 +30,12 @@ private:
     void resetCounter();
 
 private:
-    qint32 m_counterTimer = 0;
+    std::atomic<qint32> m_counterTimer { 0 };
     quint32 m_curRendered = 0;
     quint32 m_curSkipped = 0;
 
-    quint32 m_rendered = 0;
-    quint32 m_skipped = 0;
+    std::atomic<quint32> m_rendered { 0 };
+    std::atomic<quint32> m_skipped { 0 };
 };
 
 #endif // FPSCOUNTER_H
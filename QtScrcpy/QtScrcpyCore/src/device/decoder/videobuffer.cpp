@@ -1,5 +1,4 @@
 #include "videobuffer.h"
-#include "avframeconvert.h"
 extern "C"
 {
 #include "libavformat/avformat.h"
@@ -15,19 +14,18 @@ VideoBuffer::~VideoBuffer() {}
 
 bool VideoBuffer::init()
 {
-    m_decodingFrame = av_frame_alloc();
-    if (!m_decodingFrame) {
-        goto error;
-    }
-
-    m_renderingframe = av_frame_alloc();
-    if (!m_renderingframe) {
-        goto error;
+    for (int i = 0; i < 3; i++) {
+        m_frames[i] = av_frame_alloc();
+        if (!m_frames[i]) {
+            goto error;
+        }
     }
 
     // there is initially no rendering frame, so consider it has already been
     // consumed
-    m_renderingFrameConsumed = true;
+    m_decodingIndex = 0;
+    m_renderingIndex = 1;
+    m_pending = 2;
 
     m_fpsCounter.start();
     return true;
@@ -39,13 +37,11 @@ error:
 
 void VideoBuffer::deInit()
 {
-    if (m_decodingFrame) {
-        av_frame_free(&m_decodingFrame);
-        m_decodingFrame = Q_NULLPTR;
-    }
-    if (m_renderingframe) {
-        av_frame_free(&m_renderingframe);
-        m_renderingframe = Q_NULLPTR;
+    for (int i = 0; i < 3; i++) {
+        if (m_frames[i]) {
+            av_frame_free(&m_frames[i]);
+            m_frames[i] = Q_NULLPTR;
+        }
     }
     m_fpsCounter.stop();
 }
@@ -67,108 +63,75 @@ void VideoBuffer::setRenderExpiredFrames(bool renderExpiredFrames)
 
 AVFrame *VideoBuffer::decodingFrame()
 {
-    return m_decodingFrame;
+    return m_frames[m_decodingIndex];
 }
 
 void VideoBuffer::offerDecodedFrame(bool &previousFrameSkipped)
 {
-    m_mutex.lock();
-
     if (m_renderExpiredFrames) {
         // if m_renderExpiredFrames is enable, then the decoder must wait for the current
         // frame to be consumed
-        while (!m_renderingFrameConsumed && !m_interrupted) {
-            m_renderingFrameConsumedCond.wait(&m_mutex);
-        }
-    } else {
-        if (m_fpsCounter.isStarted() && !m_renderingFrameConsumed) {
-            m_fpsCounter.addSkippedFrame();
+        QMutexLocker locker(&m_consumedMutex);
+        while ((m_pending.load(std::memory_order_acquire) & s_pendingDirty) && !m_interrupted) {
+            m_renderingFrameConsumedCond.wait(&m_consumedMutex);
         }
     }
 
-    swap();
-    previousFrameSkipped = !m_renderingFrameConsumed;
-    m_renderingFrameConsumed = false;
-    m_mutex.unlock();
+    m_decodedTimes[m_decodingIndex] = qsc::VideoFrame::currentTimeUs();
+    // publish the decoded frame, and take the previous pending one to decode into
+    int previous = m_pending.exchange(m_decodingIndex | s_pendingDirty, std::memory_order_acq_rel);
+    m_decodingIndex = previous & s_pendingIndexMask;
+    previousFrameSkipped = previous & s_pendingDirty;
+
+    if (previousFrameSkipped && !m_renderExpiredFrames && m_fpsCounter.isStarted()) {
+        m_fpsCounter.addSkippedFrame();
+    }
 }
 
 const AVFrame *VideoBuffer::consumeRenderedFrame()
 {
-    Q_ASSERT(!m_renderingFrameConsumed);
-    m_renderingFrameConsumed = true;
+    if (!(m_pending.load(std::memory_order_acquire) & s_pendingDirty)) {
+        // nothing new
+        return Q_NULLPTR;
+    }
+
+    // the decoder may have offered an even newer frame in the meantime,
+    // the exchange takes it anyway
+    int previous = m_pending.exchange(m_renderingIndex, std::memory_order_acq_rel);
+    m_renderingIndex = previous & s_pendingIndexMask;
+
     if (m_fpsCounter.isStarted()) {
         m_fpsCounter.addRenderedFrame();
     }
     if (m_renderExpiredFrames) {
         // if m_renderExpiredFrames is enable, then notify the decoder the current frame is
         // consumed, so that it may push a new one
+        QMutexLocker locker(&m_consumedMutex);
         m_renderingFrameConsumedCond.wakeOne();
     }
-    return m_renderingframe;
+    return m_frames[m_renderingIndex];
 }
 
-void VideoBuffer::peekRenderedFrame(std::function<void(int width, int height, uint8_t* dataRGB32)> onFrame)
+qint64 VideoBuffer::renderedFrameDecodedTimeUs() const
 {
-    if (!onFrame) {
-        return;
-    }
-
-    lock();
-    auto frame = m_renderingframe;
-    int width = frame->width;
-    int height = frame->height;
-    int linesize = frame->linesize[0];
-
-    // create buffer
-    uint8_t* rgbBuffer = new uint8_t[linesize * height * 4];
-    AVFrame *rgbFrame = av_frame_alloc();
-    if (!rgbFrame) {
-        delete [] rgbBuffer;
-        return;
-    }
-
-    // bind buffer to AVFrame
-    av_image_fill_arrays(rgbFrame->data, rgbFrame->linesize, rgbBuffer, AV_PIX_FMT_RGB32, width, height, 4);
-
-    // convert
-    AVFrameConvert convert;
-    convert.setSrcFrameInfo(width, height, AV_PIX_FMT_YUV420P);
-    convert.setDstFrameInfo(width, height, AV_PIX_FMT_RGB32);
-    bool ret = false;
-    ret = convert.init();
-    if (!ret) {
-        delete [] rgbBuffer;
-        av_free(rgbFrame);
-        return;
-    }
-    ret = convert.convert(frame, rgbFrame);
-    if (!ret) {
-        delete [] rgbBuffer;
-        av_free(rgbFrame);
-        return;
-    }
-    convert.deInit();
-    av_free(rgbFrame);
-    unLock();
+    return m_decodedTimes[m_renderingIndex];
+}
 
-    onFrame(width, height, rgbBuffer);
-    delete [] rgbBuffer;
+qsc::VideoFrame VideoBuffer::peekRenderedFrame()
+{
+    // only a new reference is taken under the lock, the caller converts
+    // it without blocking the rendering
+    QMutexLocker locker(&m_mutex);
+    return qsc::VideoFrame(m_frames[m_renderingIndex], m_decodedTimes[m_renderingIndex]);
 }
 
 void VideoBuffer::interrupt()
 {
     if (m_renderExpiredFrames) {
-        m_mutex.lock();
+        m_consumedMutex.lock();
         m_interrupted = true;
-        m_mutex.unlock();
+        m_consumedMutex.unlock();
         // wake up blocking wait
         m_renderingFrameConsumedCond.wakeOne();
     }
 }
-
-void VideoBuffer::swap()
-{
-    AVFrame *tmp = m_decodingFrame;
-    m_decodingFrame = m_renderingframe;
-    m_renderingframe = tmp;
-}
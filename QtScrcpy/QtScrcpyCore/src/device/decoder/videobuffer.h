@@ -5,12 +5,18 @@
 #include <QWaitCondition>
 #include <QObject>
 
+#include <atomic>
 #include <functional>
 #include "fpscounter.h"
+#include "videoframe.h"
 
 // forward declarations
 typedef struct AVFrame AVFrame;
 
+// Triple buffer: the decoder writes into its own frame, the renderer reads its
+// own frame, and the third one (the newest complete frame) is exchanged between
+// them with atomic index swaps, so that decoding and rendering never wait on
+// each other.
 class VideoBuffer : public QObject
 {
     Q_OBJECT
@@ -26,17 +32,21 @@ public:
 
     AVFrame *decodingFrame();
     // set the decoder frame as ready for rendering
-    // this function locks m_mutex during its execution
-    // returns true if the previous frame had been consumed
+    // it never blocks, unless expired frames are rendered
+    // previousFrameSkipped is set if the previous frame had not been consumed
     void offerDecodedFrame(bool &previousFrameSkipped);
 
-    // mark the rendering frame as consumed and return it
-    // MUST be called with m_mutex locked!!!
-    // the caller is expected to render the returned frame to some texture before
-    // unlocking m_mutex
+    // take the newest decoded frame and return it, or Q_NULLPTR if there is
+    // no new frame since the last call
+    // the returned frame belongs to the renderer until the next call, lock()
+    // only protects it against peekRenderedFrame()
     const AVFrame *consumeRenderedFrame();
+    // when the frame returned by consumeRenderedFrame() was offered, see
+    // qsc::VideoFrame::currentTimeUs()
+    qint64 renderedFrameDecodedTimeUs() const;
 
-    void peekRenderedFrame(std::function<void(int width, int height, uint8_t* dataRGB32)> onFrame);
+    // a reference on the last rendered frame, null if none was rendered yet
+    qsc::VideoFrame peekRenderedFrame();
 
     // wake up and avoid any blocking call
     void interrupt();
@@ -45,16 +55,24 @@ signals:
     void updateFPS(quint32 fps);
 
 private:
-    void swap();
+    // m_pending holds the index of the exchanged frame, and this flag when
+    // it contains a decoded frame not consumed yet
+    static const int s_pendingDirty = 0x4;
+    static const int s_pendingIndexMask = 0x3;
 
-private:
-    AVFrame *m_decodingFrame = Q_NULLPTR;
-    AVFrame *m_renderingframe = Q_NULLPTR;
+    AVFrame *m_frames[3] = { Q_NULLPTR };
+    // written with the frame before it is published, read by its owner only
+    qint64 m_decodedTimes[3] = { 0 };
+    int m_decodingIndex = 0;  // only accessed by the decoder thread
+    int m_renderingIndex = 1; // only accessed by the rendering thread
+    std::atomic<int> m_pending { 2 };
+    // guards the rendering frame, never taken by the decoder thread
     QMutex m_mutex;
-    bool m_renderingFrameConsumed = true;
     FpsCounter m_fpsCounter;
 
     bool m_renderExpiredFrames = false;
+    // only used when expired frames are rendered
+    QMutex m_consumedMutex;
     QWaitCondition m_renderingFrameConsumedCond;
 
     // interrupted is not used if expired frames are not rendered
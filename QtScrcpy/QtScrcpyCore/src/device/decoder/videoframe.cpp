@@ -0,0 +1,86 @@
+#include <chrono>
+
+#include "videoframe.h"
+extern "C"
+{
+#include "libavutil/frame.h"
+}
+
+namespace qsc {
+
+static void frameDelete(AVFrame *frame)
+{
+    av_frame_free(&frame);
+}
+
+VideoFrame::VideoFrame() {}
+
+VideoFrame::VideoFrame(const AVFrame *frame, qint64 decodedTimeUs) : m_decodedTimeUs(decodedTimeUs)
+{
+    if (!frame) {
+        return;
+    }
+
+    AVFrame *ref = av_frame_alloc();
+    if (!ref) {
+        return;
+    }
+    if (av_frame_ref(ref, frame)) {
+        av_frame_free(&ref);
+        return;
+    }
+    m_frame = QSharedPointer<AVFrame>(ref, frameDelete);
+}
+
+bool VideoFrame::isNull() const
+{
+    return m_frame.isNull();
+}
+
+int VideoFrame::width() const
+{
+    return m_frame ? m_frame->width : 0;
+}
+
+int VideoFrame::height() const
+{
+    return m_frame ? m_frame->height : 0;
+}
+
+const uint8_t *VideoFrame::data(int plane) const
+{
+    if (!m_frame || plane < 0 || plane > 2) {
+        return Q_NULLPTR;
+    }
+    return m_frame->data[plane];
+}
+
+int VideoFrame::linesize(int plane) const
+{
+    if (!m_frame || plane < 0 || plane > 2) {
+        return 0;
+    }
+    return m_frame->linesize[plane];
+}
+
+qint64 VideoFrame::pts() const
+{
+    return m_frame ? m_frame->pts : AV_NOPTS_VALUE;
+}
+
+qint64 VideoFrame::decodedTimeUs() const
+{
+    return m_decodedTimeUs;
+}
+
+qint64 VideoFrame::currentTimeUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const AVFrame *VideoFrame::avFrame() const
+{
+    return m_frame.data();
+}
+
+}
@@ -12,6 +12,10 @@
 
 #define SC_PACKET_PTS_MASK (SC_PACKET_FLAG_KEY_FRAME - 1)
 
+// a large kernel receive buffer lets the server burst a whole key frame
+// without being throttled by the TCP window
+#define VIDEO_SOCKET_RECV_BUFFER_SIZE (4 * 1024 * 1024)
+
 typedef qint32 (*ReadPacketFunc)(void *, quint8 *, qint32);
 
 Demuxer::Demuxer(QObject *parent)
@@ -69,6 +73,7 @@ void Demuxer::deInit()
 
 void Demuxer::installVideoSocket(VideoSocket *videoSocket)
 {
+    videoSocket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, VIDEO_SOCKET_RECV_BUFFER_SIZE);
     videoSocket->moveToThread(this);
     m_videoSocket = videoSocket;
 }
@@ -78,6 +83,11 @@ void Demuxer::setFrameSize(const QSize &frameSize)
     m_frameSize = frameSize;
 }
 
+void Demuxer::setLeanMode(bool lean)
+{
+    m_lean = lean;
+}
+
 static quint32 bufferRead32be(quint8 *buf)
 {
     return static_cast<quint32>((buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3]);
@@ -114,14 +124,30 @@ void Demuxer::stopDecode()
     wait();
 }
 
+quint64 Demuxer::packetPoolHits() const
+{
+    return m_packetPool.hits();
+}
+
+quint64 Demuxer::packetPoolMisses() const
+{
+    return m_packetPool.misses();
+}
+
 void Demuxer::run()
 {
     m_codecCtx = Q_NULLPTR;
     m_parser = Q_NULLPTR;
     AVPacket *packet = Q_NULLPTR;
+    const AVCodec* codec = Q_NULLPTR;
+
+    if (m_lean) {
+        // the server already frames the packets and flags the key frames
+        goto allocPacket;
+    }
 
     // codec
-    const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    codec = avcodec_find_decoder(AV_CODEC_ID_H264);
     if (!codec) {
         qCritical("H.264 decoder not found");
         goto runQuit;
@@ -148,6 +174,7 @@ void Demuxer::run()
     // It's more complicated, but this allows to reduce the latency by 1 frame!
     m_parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
 
+allocPacket:
     packet = av_packet_alloc();
     if (!packet) {
         qCritical("OOM");
@@ -169,21 +196,27 @@ void Demuxer::run()
         }
     }
 
-    qDebug("End of frames");
+    qDebug("End of frames, packet pool hits:%llu misses:%llu", m_packetPool.hits(), m_packetPool.misses());
 
-    if (m_pending) {
-        av_packet_free(&m_pending);
+    if (m_pendingConfig) {
+        av_packet_free(&m_pendingConfig);
     }
 
     av_packet_free(&packet);
 
-    av_parser_close(m_parser);
+    if (m_parser) {
+        av_parser_close(m_parser);
+        m_parser = Q_NULLPTR;
+    }
+    m_config.clear();
 
 runQuit:
     if (m_codecCtx) {
         avcodec_free_context(&m_codecCtx);
     }
 
+    m_packetPool.deInit();
+
     if (m_videoSocket) {
         m_videoSocket->close();
         delete m_videoSocket;
@@ -226,7 +259,8 @@ bool Demuxer::recvPacket(AVPacket *packet)
     quint32 len = bufferRead32be(&header[8]);
     Q_ASSERT(len);
 
-    if (av_new_packet(packet, static_cast<int>(len))) {
+    // the payload is read once, straight into a pooled refcounted buffer
+    if (!m_packetPool.allocPacket(packet, static_cast<int>(len))) {
         qCritical("Could not allocate packet");
         return false;
     }
@@ -256,56 +290,55 @@ bool Demuxer::pushPacket(AVPacket *packet)
     bool isConfig = packet->pts == AV_NOPTS_VALUE;
 
     // A config packet must not be decoded immetiately (it contains no
-    // frame); instead, it must be concatenated with the future data packet.
-    if (m_pending || isConfig) {
-        qint32 offset;
-        if (m_pending) {
-            offset = m_pending->size;
-            if (av_grow_packet(m_pending, packet->size)) {
-                qCritical("Could not grow packet");
-                return false;
-            }
-        } else {
-            offset = 0;
-            m_pending = av_packet_alloc();
-            if (av_new_packet(m_pending, packet->size)) {
-                av_packet_free(&m_pending);
-                qCritical("Could not create packet");
-                return false;
-            }
+    // frame); instead, it is attached to the future data packet as
+    // AV_PKT_DATA_NEW_EXTRADATA side data, so that the data packet (usually
+    // a large key frame) is never copied.
+    if (isConfig) {
+        if (m_lean && !configChanged(packet)) {
+            // same SPS/PPS, the consumers already have this config
+            return processConfigPacket(packet);
         }
 
-        memcpy(m_pending->data + offset, packet->data, static_cast<unsigned int>(packet->size));
-
-        if (!isConfig) {
-            // prepare the concat packet to send to the decoder
-            m_pending->pts = packet->pts;
-            m_pending->dts = packet->dts;
-            m_pending->flags = packet->flags;
-            packet = m_pending;
+        if (!m_pendingConfig) {
+            m_pendingConfig = av_packet_alloc();
+            if (!m_pendingConfig) {
+                qCritical("OOM");
+                return false;
+            }
         }
-    }
-
-    if (isConfig) {
-        // config packet
-        bool ok = processConfigPacket(packet);
-        if (!ok) {
+        av_packet_unref(m_pendingConfig);
+        // the payload is refcounted, no copy here
+        if (av_packet_ref(m_pendingConfig, packet)) {
+            qCritical("Could not ref config packet");
             return false;
         }
-    } else {
-        // data packet
-        bool ok = parse(packet);
 
-        if (m_pending) {
-            // the pending packet must be discarded (consumed or error)
-            av_packet_free(&m_pending);
+        if (m_parser) {
+            // the parser needs the SPS/PPS to parse the slice headers of the
+            // following data packets
+            quint8 *outData = Q_NULLPTR;
+            int outLen = 0;
+            av_parser_parse2(m_parser, m_codecCtx, &outData, &outLen, packet->data, packet->size, AV_NOPTS_VALUE, AV_NOPTS_VALUE, -1);
         }
 
-        if (!ok) {
+        // config packet
+        return processConfigPacket(packet);
+    }
+
+    if (m_pendingConfig && m_pendingConfig->size > 0) {
+        // only the config itself (a few dozen bytes) is copied
+        quint8 *extradata = av_packet_new_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA, m_pendingConfig->size);
+        if (!extradata) {
+            qCritical("Could not attach config to packet");
             return false;
         }
+        memcpy(extradata, m_pendingConfig->data, static_cast<unsigned int>(m_pendingConfig->size));
+        // the pending config must be discarded (consumed)
+        av_packet_unref(m_pendingConfig);
     }
-    return true;
+
+    // data packet
+    return parse(packet);
 }
 
 bool Demuxer::processConfigPacket(AVPacket *packet)
@@ -314,8 +347,25 @@ bool Demuxer::processConfigPacket(AVPacket *packet)
     return true;
 }
 
+bool Demuxer::configChanged(const AVPacket *packet)
+{
+    // the whole config (SPS and PPS) is compared: a PPS-only change must
+    // reach the consumers too. Config packets are a few dozen bytes and are
+    // rare, so this is cheap.
+    if (m_config.size() == packet->size && !memcmp(m_config.constData(), packet->data, static_cast<size_t>(packet->size))) {
+        return false;
+    }
+    m_config = QByteArray(reinterpret_cast<const char *>(packet->data), packet->size);
+    return true;
+}
+
 bool Demuxer::parse(AVPacket *packet)
 {
+    if (!m_parser) {
+        // lean mode, the key-frame flag was set from the packet header
+        return processFrame(packet);
+    }
+
     quint8 *inData = packet->data;
     int inLen = packet->size;
     quint8 *outData = Q_NULLPTR;
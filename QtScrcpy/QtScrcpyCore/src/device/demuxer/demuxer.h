@@ -1,6 +1,7 @@
 #ifndef STREAM_H
 #define STREAM_H
 
+#include <QByteArray>
 #include <QPointer>
 #include <QSize>
 #include <QThread>
@@ -11,6 +12,8 @@ extern "C"
 #include "libavformat/avformat.h"
 }
 
+#include "packetpool.h"
+
 class VideoSocket;
 class Demuxer : public QThread
 {
@@ -25,9 +28,15 @@ public:
 
     void installVideoSocket(VideoSocket* videoSocket);
     void setFrameSize(const QSize &frameSize);
+    // lean mode trusts the server framing and key-frame flag: no parser and
+    // no codec context, for sessions without decoder (record only)
+    void setLeanMode(bool lean);
     bool startDecode();
     void stopDecode();
 
+    quint64 packetPoolHits() const;
+    quint64 packetPoolMisses() const;
+
 signals:
     void onStreamStop();
     void getFrame(AVPacket* packet);
@@ -39,18 +48,23 @@ protected:
     bool pushPacket(AVPacket *packet);
     bool processConfigPacket(AVPacket *packet);
     bool parse(AVPacket *packet);
+    bool configChanged(const AVPacket *packet);
     bool processFrame(AVPacket *packet);
     qint32 recvData(quint8 *buf, qint32 bufSize);
 
 private:
     QPointer<VideoSocket> m_videoSocket;
     QSize m_frameSize;
+    bool m_lean = false;
+    PacketPool m_packetPool;
 
     AVCodecContext *m_codecCtx = Q_NULLPTR;
     AVCodecParserContext *m_parser = Q_NULLPTR;
-    // successive packets may need to be concatenated, until a non-config
-    // packet is available
-    AVPacket* m_pending = Q_NULLPTR;
+    // the last config packet, until a non-config packet is available to
+    // carry it as side data
+    AVPacket* m_pendingConfig = Q_NULLPTR;
+    // lean mode: the last config (SPS/PPS), to only forward config changes
+    QByteArray m_config;
 };
 
 #endif // STREAM_H
@@ -0,0 +1,91 @@
+#include <QDebug>
+
+#include "packetpool.h"
+
+PacketPool::PacketPool() {}
+
+PacketPool::~PacketPool()
+{
+    deInit();
+}
+
+void PacketPool::deInit()
+{
+    for (int i = 0; i < s_sizeClassCount; i++) {
+        // buffers still referenced by the decoder/recorder keep their pool alive,
+        // the pool is really freed when the last one is released
+        av_buffer_pool_uninit(&m_pools[i]);
+    }
+}
+
+bool PacketPool::allocPacket(AVPacket *packet, int size)
+{
+    if (!packet || size <= 0) {
+        return false;
+    }
+
+    int bufferSize = size + AV_INPUT_BUFFER_PADDING_SIZE;
+    AVBufferRef *buffer = Q_NULLPTR;
+    int index = sizeClass(bufferSize);
+    if (index < 0) {
+        // too large for any size class, allocate it directly
+        m_misses++;
+        buffer = av_buffer_alloc(bufferSize);
+    } else {
+        if (!m_pools[index]) {
+            m_pools[index] = av_buffer_pool_init2(1 << (s_minSizeShift + index), this, &PacketPool::poolAlloc, Q_NULLPTR);
+            if (!m_pools[index]) {
+                return false;
+            }
+        }
+        quint64 misses = m_misses;
+        buffer = av_buffer_pool_get(m_pools[index]);
+        if (buffer && misses == m_misses) {
+            m_hits++;
+        }
+    }
+
+    if (!buffer) {
+        return false;
+    }
+
+    // a buffer of the pool may be reused, only the padding must be reset
+    memset(buffer->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    packet->buf = buffer;
+    packet->data = buffer->data;
+    packet->size = size;
+    return true;
+}
+
+quint64 PacketPool::hits() const
+{
+    return m_hits;
+}
+
+quint64 PacketPool::misses() const
+{
+    return m_misses;
+}
+
+int PacketPool::sizeClass(int size)
+{
+    for (int shift = s_minSizeShift; shift <= s_maxSizeShift; shift++) {
+        if (size <= (1 << shift)) {
+            return shift - s_minSizeShift;
+        }
+    }
+    return -1;
+}
+
+#ifdef QTSCRCPY_LAVU_HAS_SIZE_T_BUFFER_API
+AVBufferRef *PacketPool::poolAlloc(void *opaque, size_t size)
+#else
+AVBufferRef *PacketPool::poolAlloc(void *opaque, int size)
+#endif
+{
+    // only called by av_buffer_pool_get() when the pool has no free buffer
+    PacketPool *pool = static_cast<PacketPool *>(opaque);
+    pool->m_misses++;
+    return av_buffer_alloc(size);
+}
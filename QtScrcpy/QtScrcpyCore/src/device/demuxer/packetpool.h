@@ -0,0 +1,52 @@
+#ifndef PACKETPOOL_H
+#define PACKETPOOL_H
+
+#include <atomic>
+#include <QtGlobal>
+
+#include "compat.h"
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavutil/buffer.h"
+}
+
+// Size-classed pool of refcounted packet buffers.
+// Payloads are received directly into a pooled AVBufferRef which is bound to the
+// AVPacket, so decoder and recorder share it through av_packet_ref() without copy.
+// When the last reference is released, the buffer goes back to its pool.
+class PacketPool
+{
+public:
+    PacketPool();
+    virtual ~PacketPool();
+
+    void deInit();
+    // bind a pooled buffer of (at least) size bytes to an empty packet
+    // the AV_INPUT_BUFFER_PADDING_SIZE padding bytes are zeroed
+    bool allocPacket(AVPacket *packet, int size);
+
+    quint64 hits() const;
+    quint64 misses() const;
+
+private:
+    int sizeClass(int size);
+#ifdef QTSCRCPY_LAVU_HAS_SIZE_T_BUFFER_API
+    static AVBufferRef *poolAlloc(void *opaque, size_t size);
+#else
+    static AVBufferRef *poolAlloc(void *opaque, int size);
+#endif
+
+private:
+    // 4KB, 8KB ... 16MB
+    static const int s_minSizeShift = 12;
+    static const int s_maxSizeShift = 24;
+    static const int s_sizeClassCount = s_maxSizeShift - s_minSizeShift + 1;
+
+    AVBufferPool *m_pools[s_sizeClassCount] = { Q_NULLPTR };
+    std::atomic<quint64> m_hits { 0 };
+    std::atomic<quint64> m_misses { 0 };
+};
+
+#endif // PACKETPOOL_H
@@ -1,5 +1,8 @@
 #include <QDir>
+#include <QFileInfo>
 #include <QMessageBox>
+#include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 
 #include "controller.h"
@@ -7,12 +10,45 @@
 #include "decoder.h"
 #include "device.h"
 #include "filehandler.h"
+#include "framecapture.h"
+#include "frameconverter.h"
 #include "recorder.h"
+#include "replaybuffer.h"
 #include "server.h"
+#include "snapshottask.h"
 #include "demuxer.h"
 
 namespace qsc {
 
+// Finishes a recording stopped during the session, on a worker thread.
+class RecorderStopTask : public QRunnable
+{
+public:
+    explicit RecorderStopTask(const QSharedPointer<Recorder> &recorder) : m_recorder(recorder) {}
+
+    void run() override
+    {
+        m_recorder->stopRecorder();
+        m_recorder->waitRecorder();
+        m_recorder->close();
+        // deleted on its own thread, see deleteRecorder()
+        m_recorder.reset();
+    }
+
+private:
+    QSharedPointer<Recorder> m_recorder;
+};
+
+// the last reference may be dropped on a worker or on the demuxer thread
+static void deleteRecorder(Recorder *recorder)
+{
+    if (recorder->thread() == QThread::currentThread()) {
+        delete recorder;
+    } else {
+        recorder->deleteLater();
+    }
+}
+
 Device::Device(DeviceParams params, QObject *parent) : IDevice(parent), m_params(params)
 {
     if (!params.display && !m_params.recordFile) {
@@ -26,6 +62,18 @@ Device::Device(DeviceParams params, QObject *parent) : IDevice(parent), m_params
                 item->onFrame(width, height, dataY, dataU, dataV, linesizeY, linesizeU, linesizeV);
             }
         }, this);
+        m_frameCapture = new FrameCapture(params.serial);
+        m_decoder->setOnVideoFrame([this](const VideoFrame &frame) {
+            for (const auto& item : m_deviceObservers) {
+                item->onVideoFrame(frame);
+            }
+        });
+        m_decoder->setOnDecodedFrame([this](const AVFrame *frame) {
+            // only take a reference on the frame while capturing
+            if (m_frameCapture->isCapturing()) {
+                m_frameCapture->push(VideoFrame(frame, VideoFrame::currentTimeUs()));
+            }
+        });
         m_fileHandler = new FileHandler(this);
         m_controller = new Controller([this](const QByteArray& buffer) -> qint64 {
             if (!m_server || !m_server->getControlSocket()) {
@@ -36,28 +84,17 @@ Device::Device(DeviceParams params, QObject *parent) : IDevice(parent), m_params
         }, params.gameScript, this);
     }
 
+    if (params.replayDuration > 0) {
+        m_replayBuffer = new ReplayBuffer(static_cast<qint64>(params.replayDuration) * 1000000, static_cast<quint64>(params.replaySize) * 1024 * 1024);
+    }
+
     m_stream = new Demuxer(this);
+    // record only: no decoder, no need to parse the stream
+    m_stream->setLeanMode(!params.display);
 
     m_server = new Server(this);
     if (m_params.recordFile && !m_params.recordPath.trimmed().isEmpty()) {
-        QString absFilePath;
-        QString fileDir(m_params.recordPath);
-        if (!fileDir.isEmpty()) {
-            QDateTime dateTime = QDateTime::currentDateTime();
-            QString fileName = dateTime.toString("_yyyyMMdd_hhmmss_zzz");
-            fileName = m_params.serial + fileName;
-            fileName.replace(":", "_");
-            fileName.replace(".", "_");
-            fileName += ("." + m_params.recordFileFormat);
-            QDir dir(fileDir);
-            if (!dir.exists()) {
-                if (!dir.mkpath(fileDir)) {
-                    qCritical() << QString("Failed to create the save folder: %1").arg(fileDir);
-                }
-            }
-            absFilePath = dir.absoluteFilePath(fileName);
-        }
-        m_recorder = new Recorder(absFilePath, this);
+        m_recorder = createRecorder(recordFilePath(""));
     }
     initSignals();
 }
@@ -65,6 +102,16 @@ Device::Device(DeviceParams params, QObject *parent) : IDevice(parent), m_params
 Device::~Device()
 {
     Device::disconnectDevice();
+    // the decoder thread is stopped, wait for the captures in progress
+    if (m_frameCapture) {
+        delete m_frameCapture;
+        m_frameCapture = Q_NULLPTR;
+    }
+    // the demuxer thread is stopped too
+    if (m_replayBuffer) {
+        delete m_replayBuffer;
+        m_replayBuffer = Q_NULLPTR;
+    }
 }
 
 void Device::setUserData(void *data)
@@ -92,6 +139,33 @@ const QString &Device::getSerial()
     return m_params.serial;
 }
 
+DeviceStats Device::getStats()
+{
+    DeviceStats stats;
+    if (m_stream) {
+        stats.packetPoolHits = m_stream->packetPoolHits();
+        stats.packetPoolMisses = m_stream->packetPoolMisses();
+    }
+    if (m_decoder) {
+        stats.decoderQueueDepth = m_decoder->queueDepth();
+        stats.decoderQueuePeak = m_decoder->queuePeak();
+        stats.decoderDroppedPackets = m_decoder->droppedPackets();
+        stats.decoderSkippedPackets = m_decoder->skippedPackets();
+    }
+    if (m_recorder) {
+        stats.recorderQueueBytes = m_recorder->queueBytes();
+        stats.recorderQueuePeakBytes = m_recorder->queuePeakBytes();
+        stats.recorderQueuePeak = m_recorder->queuePeak();
+        stats.recorderDroppedPackets = m_recorder->droppedPackets();
+    }
+    if (m_frameCapture) {
+        stats.captureFrames = m_frameCapture->captured();
+        stats.captureDropped = m_frameCapture->dropped();
+        stats.capturePending = m_frameCapture->pending();
+    }
+    return stats;
+}
+
 void Device::updateScript(QString script)
 {
     if (m_controller) {
@@ -106,9 +180,40 @@ void Device::screenshot()
     }
 
     // screenshot
-    m_decoder->peekFrame([this](int width, int height, uint8_t* dataRGB32) {
-       saveFrame(width, height, dataRGB32);
-    });
+    VideoFrame frame = m_decoder->peekFrame();
+    if (frame.isNull()) {
+        return;
+    }
+    saveFrame(frame);
+}
+
+bool Device::startCapture(const CaptureParams &params)
+{
+    if (!m_frameCapture) {
+        return false;
+    }
+    if (!m_frameCapture->start(params, m_params.recordPath)) {
+        return false;
+    }
+    updateKeyFramesOnly();
+    return true;
+}
+
+void Device::stopCapture()
+{
+    if (!m_frameCapture) {
+        return;
+    }
+    m_frameCapture->stop();
+    updateKeyFramesOnly();
+}
+
+bool Device::isCapturing()
+{
+    if (!m_frameCapture) {
+        return false;
+    }
+    return m_frameCapture->isCapturing();
 }
 
 void Device::showTouch(bool show)
@@ -127,6 +232,145 @@ void Device::showTouch(bool show)
     qInfo() << getSerial() << " show touch " << (show ? "enable" : "disable");
 }
 
+bool Device::saveReplay(const QString &fileName)
+{
+    if (!m_replayBuffer) {
+        return false;
+    }
+
+    QString absFilePath = fileName.isEmpty() ? recordFilePath("_replay") : fileName;
+    if (absFilePath.isEmpty()) {
+        qWarning() << "please select record save path!!!";
+        return false;
+    }
+    QString suffix = QFileInfo(absFilePath).suffix();
+    if (suffix != "mp4" && suffix != "mkv") {
+        qWarning() << QString("replay must be saved as mp4 or mkv: %1").arg(absFilePath).toUtf8().toStdString().c_str();
+        return false;
+    }
+
+    if (!m_replayBuffer->save(absFilePath)) {
+        qWarning() << "replay buffer is empty";
+        return false;
+    }
+    qInfo() << QString("saving replay %1").arg(absFilePath).toUtf8().toStdString().c_str();
+    return true;
+}
+
+bool Device::startRecording(const QString &fileName)
+{
+    if (!m_serverStartSuccess || isRecording()) {
+        return false;
+    }
+    {
+        QMutexLocker locker(&m_recorderMutex);
+        if (m_config.isEmpty()) {
+            qWarning("No config packet received yet, cannot record");
+            return false;
+        }
+    }
+    QString absFilePath = fileName.isEmpty() ? recordFilePath("") : fileName;
+    if (absFilePath.isEmpty()) {
+        qWarning() << "please select record save path!!!";
+        return false;
+    }
+    QString suffix = QFileInfo(absFilePath).suffix();
+    if (suffix != "mp4" && suffix != "mkv") {
+        qWarning() << QString("record must be saved as mp4 or mkv: %1").arg(absFilePath).toUtf8().toStdString().c_str();
+        return false;
+    }
+
+    // a recording which failed is finished first
+    stopRecording();
+    QSharedPointer<Recorder> recorder = createRecorder(absFilePath);
+    recorder->setFrameSize(m_frameSize);
+    if (!recorder->open()) {
+        qCritical("Could not open recorder");
+        return false;
+    }
+    recorder->startRecorder();
+
+    bool requestKeyFrame = true;
+    {
+        // no packet can come in between
+        QMutexLocker locker(&m_recorderMutex);
+        QByteArray config = m_config;
+        QList<AVPacket *> gop;
+        if (m_replayBuffer) {
+            // start from the last key frame, already received
+            QByteArray gopConfig;
+            gop = m_replayBuffer->lastGop(gopConfig);
+            if (!gop.isEmpty() && !gopConfig.isEmpty()) {
+                config = gopConfig;
+                requestKeyFrame = false;
+            }
+        }
+        recorder->pushConfig(config);
+        for (AVPacket *packet : gop) {
+            if (!requestKeyFrame) {
+                // push() may block on the queue budget, not with the lock held
+                recorder->preroll(packet);
+            }
+            av_packet_free(&packet);
+        }
+        m_recorder = recorder;
+    }
+    if (requestKeyFrame && m_controller) {
+        // the packets are skipped until then, don't wait for the next
+        // key frame (up to the i-frame interval)
+        m_controller->resetVideo();
+    }
+    qInfo() << QString("start record %1").arg(absFilePath).toUtf8().toStdString().c_str();
+    return true;
+}
+
+void Device::stopRecording()
+{
+    QSharedPointer<Recorder> recorder;
+    {
+        QMutexLocker locker(&m_recorderMutex);
+        recorder = m_recorder;
+        m_recorder.reset();
+    }
+    if (!recorder) {
+        return;
+    }
+    // writing the queued packets and the trailer may take a while, the
+    // session goes on meanwhile
+    QThreadPool::globalInstance()->start(new RecorderStopTask(recorder));
+}
+
+bool Device::isRecording()
+{
+    return m_recorder && m_recorder->isRunning();
+}
+
+void Device::setVideoVisible(bool visible)
+{
+    m_videoVisible = visible;
+    updateKeyFramesOnly();
+}
+
+void Device::updateKeyFramesOnly()
+{
+    if (!m_decoder) {
+        return;
+    }
+    // a capture which ends by itself keeps every frame decoded until the
+    // next visibility change
+    bool keyFramesOnly = !m_videoVisible && !isCapturing();
+    if (m_keyFramesOnly == keyFramesOnly) {
+        return;
+    }
+    m_keyFramesOnly = keyFramesOnly;
+    m_decoder->setKeyFramesOnly(keyFramesOnly);
+    if (!keyFramesOnly && m_controller) {
+        // don't wait for the next key frame (up to the i-frame interval)
+        m_controller->resetVideo();
+    }
+    qInfo() << getSerial() << (keyFramesOnly ? " video hidden, decoding key frames only" : " video visible, decoding every frame");
+}
+
 bool Device::isReversePort(quint16 port)
 {
     if (m_server && m_server->isReverse() && port == m_server->getParams().localPort) {
@@ -193,9 +437,26 @@ void Device::initSignals()
                     }
                 }
 
+                m_frameSize = size;
+                if (m_replayBuffer) {
+                    m_replayBuffer->setFrameSize(size);
+                }
+
                 // init decoder
                 if (m_decoder) {
-                    m_decoder->open();
+                    Decoder::ThreadMode threadMode = Decoder::THREAD_MODE_AUTO;
+                    if (m_params.decoderThreadMode == Decoder::THREAD_MODE_SLICE || m_params.decoderThreadMode == Decoder::THREAD_MODE_FRAME) {
+                        threadMode = static_cast<Decoder::ThreadMode>(m_params.decoderThreadMode);
+                    }
+                    m_decoder->setFrameSize(size);
+                    m_decoder->setThreadMode(threadMode, m_params.decoderThreads);
+                    if (!m_decoder->open()) {
+                        qCritical("Could not open decoder");
+                    }
+
+                    if (!m_decoder->startDecoder()) {
+                        qCritical("Could not start decoder");
+                    }
                 }
 
                 // init stream
@@ -246,12 +507,32 @@ void Device::initSignals()
                 qCritical("Could not send packet to decoder");
             }
 
-            if (m_recorder && !m_recorder->push(packet)) {
+            // the recorder may be started or stopped from the main thread,
+            // which takes the lock too: never push (which may block) with it
+            QSharedPointer<Recorder> recorder;
+            {
+                QMutexLocker locker(&m_recorderMutex);
+                recorder = m_recorder;
+                if (m_replayBuffer) {
+                    m_replayBuffer->push(packet);
+                }
+            }
+            if (recorder && !recorder->push(packet)) {
                 qCritical("Could not send packet to recorder");
             }
         }, Qt::DirectConnection);
         connect(m_stream, &Demuxer::getConfigFrame, this, [this](AVPacket *packet) {
-            if (m_recorder && !m_recorder->push(packet)) {
+            QSharedPointer<Recorder> recorder;
+            {
+                QMutexLocker locker(&m_recorderMutex);
+                // the header of a recording started later
+                m_config = QByteArray(reinterpret_cast<const char *>(packet->data), packet->size);
+                recorder = m_recorder;
+                if (m_replayBuffer) {
+                    m_replayBuffer->push(packet);
+                }
+            }
+            if (recorder && !recorder->push(packet)) {
                 qCritical("Could not send config packet to recorder");
             }
         }, Qt::DirectConnection);
@@ -263,6 +544,12 @@ void Device::initSignals()
                 item->updateFPS(fps);
             }
         });
+        connect(m_decoder, &Decoder::keyFrameRequested, this, [this]() {
+            // don't wait for the next key frame (up to the i-frame interval)
+            if (m_controller) {
+                m_controller->resetVideo();
+            }
+        });
     }
 }
 
@@ -320,14 +607,17 @@ void Device::disconnectDevice()
 
     // server must stop before decoder, because decoder block main thread
     if (m_decoder) {
+        if (m_decoder->isRunning()) {
+            m_decoder->stopDecoder();
+        }
         m_decoder->close();
     }
 
     if (m_recorder) {
-        if (m_recorder->isRunning()) {
-            m_recorder->stopRecorder();
-            m_recorder->wait();
-        }
+        // even after a write error: a writer may still use the output until
+        // waitRecorder() returns
+        m_recorder->stopRecorder();
+        m_recorder->waitRecorder();
         m_recorder->close();
     }
 
@@ -621,13 +911,45 @@ bool Device::isCurrentCustomKeymap()
     return m_controller->isCurrentCustomKeymap();
 }
 
-bool Device::saveFrame(int width, int height, uint8_t* dataRGB32)
+QString Device::recordFilePath(const QString &tag)
 {
-    if (!dataRGB32) {
-        return false;
+    QString fileDir(m_params.recordPath.trimmed());
+    if (fileDir.isEmpty()) {
+        return "";
     }
+    QDateTime dateTime = QDateTime::currentDateTime();
+    QString fileName = dateTime.toString("_yyyyMMdd_hhmmss_zzz");
+    fileName = m_params.serial + tag + fileName;
+    fileName.replace(":", "_");
+    fileName.replace(".", "_");
+    fileName += ("." + m_params.recordFileFormat);
+    QDir dir(fileDir);
+    if (!dir.exists()) {
+        if (!dir.mkpath(fileDir)) {
+            qCritical() << QString("Failed to create the save folder: %1").arg(fileDir);
+        }
+    }
+    return dir.absoluteFilePath(fileName);
+}
+
+QSharedPointer<Recorder> Device::createRecorder(const QString &absFilePath)
+{
+    QSharedPointer<Recorder> recorder(new Recorder(absFilePath), deleteRecorder);
+    recorder->setSegmented(m_params.recordSegmented, static_cast<qint64>(m_params.recordSegmentDuration) * 1000000,
+                           static_cast<qint64>(m_params.recordSegmentSize) * 1024 * 1024);
+    Recorder::QueuePolicy queuePolicy = Recorder::QUEUE_POLICY_BLOCK;
+    if (m_params.recordQueuePolicy == Recorder::QUEUE_POLICY_DROP_NON_REF || m_params.recordQueuePolicy == Recorder::QUEUE_POLICY_DROP_TO_KEY_FRAME) {
+        queuePolicy = static_cast<Recorder::QueuePolicy>(m_params.recordQueuePolicy);
+    }
+    recorder->setQueueLimit(static_cast<quint64>(m_params.recordQueueSize) * 1024 * 1024, queuePolicy);
+    return recorder;
+}
 
-    QImage rgbImage(dataRGB32, width, height, QImage::Format_RGB32);
+bool Device::saveFrame(const VideoFrame &frame)
+{
+    if (frame.isNull()) {
+        return false;
+    }
 
     // save
     QString absFilePath;
@@ -641,15 +963,16 @@ bool Device::saveFrame(int width, int height, uint8_t* dataRGB32)
     fileName = m_params.serial + fileName;
     fileName.replace(":", "_");
     fileName.replace(".", "_");
-    fileName += ".png";
+    fileName += "." + SnapshotTask::fileSuffix(m_params.screenshotFormat);
     QDir dir(fileDir);
     absFilePath = dir.absoluteFilePath(fileName);
-    int ret = rgbImage.save(absFilePath, "PNG", 100);
-    if (!ret) {
-        return false;
-    }
 
-    qInfo() << "screenshot save to " << absFilePath;
+    if (!m_frameConverter) {
+        m_frameConverter.reset(new FrameConverter());
+    }
+    // convert and encode on a worker thread, the task only holds a
+    // reference on the frame
+    QThreadPool::globalInstance()->start(new SnapshotTask(m_frameConverter, frame, absFilePath, m_params.screenshotFormat, m_params.screenshotQuality));
     return true;
 }
 
@@ -3,7 +3,9 @@
 
 #include <set>
 #include <QElapsedTimer>
+#include <QMutex>
 #include <QPointer>
+#include <QSharedPointer>
 #include <QTime>
 
 #include "../../include/QtScrcpyCore.h"
@@ -19,6 +21,9 @@ class FileHandler;
 class Demuxer;
 class VideoForm;
 class Controller;
+class FrameConverter;
+class FrameCapture;
+class ReplayBuffer;
 struct AVFrame;
 
 namespace qsc {
@@ -66,17 +71,29 @@ public:
     void installApkRequest(const QString &apkFile) override;
 
     void screenshot() override;
+    bool startCapture(const CaptureParams &params) override;
+    void stopCapture() override;
+    bool isCapturing() override;
+    bool saveReplay(const QString &fileName = "") override;
+    bool startRecording(const QString &fileName = "") override;
+    void stopRecording() override;
+    bool isRecording() override;
     void showTouch(bool show) override;
+    void setVideoVisible(bool visible) override;
 
     bool isReversePort(quint16 port) override;
     const QString &getSerial() override;
+    DeviceStats getStats() override;
 
     void updateScript(QString script) override;
     bool isCurrentCustomKeymap() override;
 
 private:
     void initSignals();
-    bool saveFrame(int width, int height, uint8_t* dataRGB32);
+    bool saveFrame(const VideoFrame &frame);
+    void updateKeyFramesOnly();
+    QString recordFilePath(const QString &tag);
+    QSharedPointer<Recorder> createRecorder(const QString &absFilePath);
 
 private:
     // server relevant
@@ -86,7 +103,21 @@ private:
     QPointer<Controller> m_controller;
     QPointer<FileHandler> m_fileHandler;
     QPointer<Demuxer> m_stream;
-    QPointer<Recorder> m_recorder;
+    // the demuxer thread pushes to its own reference, without the lock
+    QSharedPointer<Recorder> m_recorder;
+    // guards m_recorder and m_config, used from the demuxer thread
+    QMutex m_recorderMutex;
+    // the last config packet, for the recordings started later
+    QByteArray m_config;
+    QSize m_frameSize;
+    // shared with the screenshot tasks, which may outlive the device
+    QSharedPointer<FrameConverter> m_frameConverter;
+    // fed from the decoder thread
+    FrameCapture *m_frameCapture = Q_NULLPTR;
+    // fed from the demuxer thread
+    ReplayBuffer *m_replayBuffer = Q_NULLPTR;
+    bool m_videoVisible = true;
+    bool m_keyFramesOnly = false;
 
     QElapsedTimer m_startTimeCount;
     DeviceParams m_params;
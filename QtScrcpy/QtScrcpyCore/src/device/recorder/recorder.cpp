@@ -1,15 +1,24 @@
 #include <QCoreApplication>
 #include <QDebug>
+#include <QDir>
 #include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 #include "compat.h"
 #include "recorder.h"
+#include "recorderservice.h"
 
 static const AVRational SCRCPY_TIME_BASE = { 1, 1000000 }; // timestamps in us
 
-Recorder::Recorder(const QString &fileName, QObject *parent) : QThread(parent), m_fileName(fileName), m_format(guessRecordFormat(fileName)) {}
+Recorder::Recorder(const QString &fileName, QObject *parent) : QObject(parent), m_fileName(fileName), m_format(guessRecordFormat(fileName)) {}
 
-Recorder::~Recorder() {}
+Recorder::~Recorder()
+{
+    // a writer may still hold it, even when isRunning() is false
+    stopRecorder();
+    waitRecorder();
+}
 
 AVPacket *Recorder::packetNew(const AVPacket *packet)
 {
@@ -36,6 +45,92 @@ void Recorder::queueClear()
     while (!m_queue.isEmpty()) {
         packetDelete(m_queue.dequeue());
     }
+    m_queueBytes = 0;
+    m_queueSpaceCond.wakeAll();
+}
+
+bool Recorder::queueFull(const AVPacket *packet)
+{
+    // a packet larger than the budget still goes in an empty queue
+    return m_maxQueueBytes && !m_queue.isEmpty() && m_queueBytes + static_cast<quint64>(packet->size) > m_maxQueueBytes;
+}
+
+void Recorder::queuePacket(AVPacket *packet)
+{
+    if (!m_droppedConfig.isEmpty() && !av_packet_get_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA, Q_NULLPTR)) {
+        quint8 *extradata = av_packet_new_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA, m_droppedConfig.size());
+        if (extradata) {
+            memcpy(extradata, m_droppedConfig.constData(), static_cast<size_t>(m_droppedConfig.size()));
+        }
+    }
+    m_droppedConfig.clear();
+
+    m_queue.enqueue(packet);
+    m_queueBytes += static_cast<quint64>(packet->size);
+    m_queuePeakBytes = qMax(m_queuePeakBytes, m_queueBytes);
+    m_queuePeak = qMax(m_queuePeak, static_cast<quint32>(m_queue.size()));
+    scheduleLocked();
+}
+
+void Recorder::scheduleLocked()
+{
+    if (m_scheduled || !m_running || m_finished) {
+        return;
+    }
+    m_scheduled = true;
+    RecorderService::getInstance().schedule(this);
+}
+
+void Recorder::dropPacket(const AVPacket *packet)
+{
+    // a config must survive the packet carrying it, the next key frame
+    // may depend on it
+#ifdef QTSCRCPY_LAVU_HAS_SIZE_T_BUFFER_API
+    size_t configSize = 0;
+#else
+    int configSize = 0;
+#endif
+    quint8 *config = av_packet_get_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA, &configSize);
+    if (config && configSize > 0) {
+        m_droppedConfig = QByteArray(reinterpret_cast<const char *>(config), static_cast<int>(configSize));
+    }
+    m_droppedPackets++;
+}
+
+void Recorder::dropQueuedNonRef()
+{
+    for (int i = 0; i < m_queue.size();) {
+        AVPacket *packet = m_queue.at(i);
+        if (packet->pts == AV_NOPTS_VALUE || !isNonRef(packet)) {
+            i++;
+            continue;
+        }
+        m_queue.removeAt(i);
+        m_queueBytes -= static_cast<quint64>(packet->size);
+        dropPacket(packet);
+        packetDelete(packet);
+    }
+}
+
+bool Recorder::isNonRef(const AVPacket *packet)
+{
+    if (packet->flags & AV_PKT_FLAG_KEY) {
+        return false;
+    }
+    // H.264 annex B: nal_ref_idc of the first slice
+    const quint8 *data = packet->data;
+    for (int i = 0; i + 3 < packet->size; i++) {
+        if (data[i] || data[i + 1] || data[i + 2] != 1) {
+            continue;
+        }
+        quint8 header = data[i + 3];
+        int type = header & 0x1f;
+        if (type == 1 || type == 5) {
+            return !(header & 0x60);
+        }
+        i += 2;
+    }
+    return false;
 }
 
 void Recorder::setFrameSize(const QSize &declaredFrameSize)
@@ -48,7 +143,50 @@ void Recorder::setFormat(Recorder::RecorderFormat format)
     m_format = format;
 }
 
+void Recorder::setSegmented(bool segmented, qint64 maxDurationUs, qint64 maxBytes)
+{
+    m_segmented = segmented;
+    m_maxSegmentDurationUs = maxDurationUs;
+    m_maxSegmentBytes = maxBytes;
+}
+
 bool Recorder::open()
+{
+    if (!m_segmented) {
+        return openOutput(m_fileName);
+    }
+
+    QFileInfo fileInfo(m_fileName);
+    m_indexFile.setFileName(fileInfo.dir().absoluteFilePath(fileInfo.completeBaseName() + ".jsonl"));
+    if (!m_indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << QString("Failed to open recording index: %1").arg(m_indexFile.fileName()).toUtf8().toStdString().c_str();
+    }
+    m_segment = 0;
+    m_segmentStartUs = 0;
+    return openOutput(segmentFileName(m_segment));
+}
+
+void Recorder::close()
+{
+    if (Q_NULLPTR != m_formatCtx) {
+        if (m_headerWritten) {
+            if (closeOutput()) {
+                qInfo() << QString("success record %1").arg(m_outputFileName).toStdString().c_str();
+            } else {
+                m_failed = true;
+            }
+        } else {
+            // the recorded file is empty
+            closeOutput();
+            m_failed = true;
+        }
+    }
+    if (m_indexFile.isOpen()) {
+        m_indexFile.close();
+    }
+}
+
+bool Recorder::openOutput(const QString &fileName)
 {
     // codec
     const AVCodec* inputCodec = avcodec_find_decoder(AV_CODEC_ID_H264);
@@ -77,7 +215,6 @@ bool Recorder::open()
     // <https://github.com/FFmpeg/FFmpeg/commit/0694d8702421e7aff1340038559c438b61bb30dd>
 
     m_formatCtx->oformat = (AVOutputFormat *)format;
-
     QString comment = "Recorded by QtScrcpy " + QCoreApplication::applicationVersion();
     av_dict_set(&m_formatCtx->metadata, "comment", comment.toUtf8(), 0);
 
@@ -102,39 +239,49 @@ bool Recorder::open()
     outStream->codec->height = m_declaredFrameSize.height();
 #endif
 
-    int ret = avio_open(&m_formatCtx->pb, m_fileName.toUtf8().toStdString().c_str(), AVIO_FLAG_WRITE);
+    int ret = avio_open(&m_formatCtx->pb, fileName.toUtf8().toStdString().c_str(), AVIO_FLAG_WRITE);
     if (ret < 0) {
         char errorbuf[255] = { 0 };
         av_strerror(ret, errorbuf, 254);
-        qCritical() << QString("Failed to open output file: %1 %2").arg(errorbuf).arg(m_fileName).toUtf8().toStdString().c_str();
+        qCritical() << QString("Failed to open output file: %1 %2").arg(errorbuf).arg(fileName).toUtf8().toStdString().c_str();
         // ostream will be cleaned up during context cleaning
         avformat_free_context(m_formatCtx);
         m_formatCtx = Q_NULLPTR;
         return false;
     }
+    m_outputFileName = fileName;
 
     return true;
 }
 
-void Recorder::close()
+bool Recorder::closeOutput()
 {
-    if (Q_NULLPTR != m_formatCtx) {
-        if (m_headerWritten) {
-            int ret = av_write_trailer(m_formatCtx);
-            if (ret < 0) {
-                qCritical() << QString("Failed to write trailer to %1").arg(m_fileName).toUtf8().toStdString().c_str();
-                m_failed = true;
-            } else {
-                qInfo() << QString("success record %1").arg(m_fileName).toStdString().c_str();
-            }
-        } else {
-            // the recorded file is empty
-            m_failed = true;
+    if (Q_NULLPTR == m_formatCtx) {
+        return false;
+    }
+    bool ok = true;
+    if (m_headerWritten) {
+        int ret = av_write_trailer(m_formatCtx);
+        if (ret < 0) {
+            qCritical() << QString("Failed to write trailer to %1").arg(m_outputFileName).toUtf8().toStdString().c_str();
+            ok = false;
+        }
+        if (m_segmented) {
+            QJsonObject entry;
+            entry["segment"] = m_segment;
+            entry["file"] = QFileInfo(m_outputFileName).fileName();
+            entry["startUs"] = m_segmentStartUs;
+            entry["durationUs"] = m_lastPtsUs - m_segmentStartUs;
+            entry["bytes"] = static_cast<qint64>(avio_tell(m_formatCtx->pb));
+            entry["complete"] = ok;
+            writeIndex(entry);
         }
-        avio_close(m_formatCtx->pb);
-        avformat_free_context(m_formatCtx);
-        m_formatCtx = Q_NULLPTR;
     }
+    avio_close(m_formatCtx->pb);
+    avformat_free_context(m_formatCtx);
+    m_formatCtx = Q_NULLPTR;
+    m_headerWritten = false;
+    return ok;
 }
 
 bool Recorder::write(AVPacket *packet)
@@ -144,7 +291,8 @@ bool Recorder::write(AVPacket *packet)
             qCritical("The first packet is not a config packet");
             return false;
         }
-        bool ok = recorderWriteHeader(packet);
+        m_config = QByteArray(reinterpret_cast<const char *>(packet->data), packet->size);
+        bool ok = recorderWriteHeader(m_config);
         if (!ok) {
             return false;
         }
@@ -157,8 +305,87 @@ bool Recorder::write(AVPacket *packet)
         return true;
     }
 
+    bool isKeyFrame = packet->flags & AV_PKT_FLAG_KEY;
+    if (isKeyFrame && segmentFull(packet)) {
+        if (!nextSegment(packet->pts)) {
+            return false;
+        }
+    }
+
+    if (!recorderInlineConfig(packet)) {
+        return false;
+    }
+
+    qint64 ptsUs = packet->pts;
+    m_lastPtsUs = ptsUs + packet->duration;
+    // each segment starts at 0
+    packet->pts -= m_segmentStartUs;
+    packet->dts = packet->pts;
     recorderRescalePacket(packet);
-    return av_write_frame(m_formatCtx, packet) >= 0;
+    if (av_write_frame(m_formatCtx, packet) < 0) {
+        return false;
+    }
+
+    if (m_segmented && isKeyFrame) {
+        // the fragment (or cluster) of this key frame starts where the
+        // previous one was flushed
+        QJsonObject entry;
+        entry["segment"] = m_segment;
+        entry["keyFrameUs"] = ptsUs;
+        entry["offset"] = static_cast<qint64>(avio_tell(m_formatCtx->pb));
+        writeIndex(entry);
+    }
+    return true;
+}
+
+bool Recorder::segmentFull(const AVPacket *packet)
+{
+    if (!m_segmented) {
+        return false;
+    }
+    if (m_maxSegmentDurationUs > 0 && packet->pts - m_segmentStartUs >= m_maxSegmentDurationUs) {
+        return true;
+    }
+    return m_maxSegmentBytes > 0 && avio_tell(m_formatCtx->pb) >= m_maxSegmentBytes;
+}
+
+bool Recorder::nextSegment(qint64 startUs)
+{
+    bool ok = closeOutput();
+    if (!ok) {
+        qWarning() << QString("Segment %1 may be truncated").arg(m_outputFileName).toUtf8().toStdString().c_str();
+    }
+    m_segment++;
+    m_segmentStartUs = startUs;
+    if (!openOutput(segmentFileName(m_segment))) {
+        return false;
+    }
+    // the latest config, the previous ones were written in-band
+    if (!recorderWriteHeader(m_config)) {
+        return false;
+    }
+    m_headerWritten = true;
+    qInfo() << QString("record segment %1").arg(m_outputFileName).toStdString().c_str();
+    return true;
+}
+
+QString Recorder::segmentFileName(int segment)
+{
+    QFileInfo fileInfo(m_fileName);
+    QString fileName = QString("%1_%2.%3").arg(fileInfo.completeBaseName()).arg(segment, 3, 10, QChar('0')).arg(fileInfo.suffix());
+    return fileInfo.dir().absoluteFilePath(fileName);
+}
+
+void Recorder::writeIndex(const QJsonObject &entry)
+{
+    if (!m_indexFile.isOpen()) {
+        return;
+    }
+    // one line at a time, a crash loses at most the line being written
+    QByteArray line = QJsonDocument(entry).toJson(QJsonDocument::Compact);
+    line.append('\n');
+    m_indexFile.write(line);
+    m_indexFile.flush();
 }
 
 const AVOutputFormat *Recorder::findMuxer(const char *name)
@@ -178,26 +405,33 @@ const AVOutputFormat *Recorder::findMuxer(const char *name)
     return outFormat;
 }
 
-bool Recorder::recorderWriteHeader(const AVPacket *packet)
+bool Recorder::recorderWriteHeader(const QByteArray &config)
 {
     AVStream *ostream = m_formatCtx->streams[0];
-    quint8 *extradata = (quint8 *)av_malloc(packet->size * sizeof(quint8));
+    quint8 *extradata = (quint8 *)av_mallocz(config.size() + AV_INPUT_BUFFER_PADDING_SIZE);
     if (!extradata) {
         qCritical("Cannot allocate extradata");
         return false;
     }
-    // copy the first packet to the extra data
-    memcpy(extradata, packet->data, packet->size);
+    // copy the config packet to the extra data
+    memcpy(extradata, config.constData(), config.size());
 
 #ifdef QTSCRCPY_LAVF_HAS_NEW_CODEC_PARAMS_API
     ostream->codecpar->extradata = extradata;
-    ostream->codecpar->extradata_size = packet->size;
+    ostream->codecpar->extradata_size = config.size();
 #else
     ostream->codec->extradata = extradata;
-    ostream->codec->extradata_size = packet->size;
+    ostream->codec->extradata_size = config.size();
 #endif
 
-    int ret = avformat_write_header(m_formatCtx, NULL);
+    AVDictionary *options = Q_NULLPTR;
+    if (m_segmented && m_format == RECORDER_FORMAT_MP4) {
+        // no moov to write at the end: a fragment per key frame, each one
+        // playable as soon as it is flushed
+        av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    }
+    int ret = avformat_write_header(m_formatCtx, &options);
+    av_dict_free(&options);
     if (ret < 0) {
         qCritical("Failed to write header recorder file");
         return false;
@@ -205,6 +439,49 @@ bool Recorder::recorderWriteHeader(const AVPacket *packet)
     return true;
 }
 
+bool Recorder::recorderInlineConfig(AVPacket *packet)
+{
+#ifdef QTSCRCPY_LAVU_HAS_SIZE_T_BUFFER_API
+    size_t configSize = 0;
+#else
+    int configSize = 0;
+#endif
+    quint8 *config = av_packet_get_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA, &configSize);
+    if (!config || configSize <= 0) {
+        return true;
+    }
+
+#ifdef QTSCRCPY_LAVF_HAS_NEW_CODEC_PARAMS_API
+    AVCodecParameters *par = m_formatCtx->streams[0]->codecpar;
+#else
+    AVCodecContext *par = m_formatCtx->streams[0]->codec;
+#endif
+    if (static_cast<int>(configSize) != par->extradata_size || memcmp(config, par->extradata, configSize)) {
+        // the config changed (e.g. the device rotated), the muxers cannot
+        // update the header, so the new config is written in-band, in front
+        // of the frame
+        m_config = QByteArray(reinterpret_cast<const char *>(config), static_cast<int>(configSize));
+        int size = static_cast<int>(configSize) + packet->size;
+        AVBufferRef *buffer = av_buffer_alloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!buffer) {
+            qCritical("Could not allocate packet");
+            return false;
+        }
+        memcpy(buffer->data, config, configSize);
+        memcpy(buffer->data + configSize, packet->data, static_cast<unsigned int>(packet->size));
+        memset(buffer->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+        av_buffer_unref(&packet->buf);
+        packet->buf = buffer;
+        packet->data = buffer->data;
+        packet->size = size;
+    }
+
+    // the config is either in the header or in-band now
+    av_packet_free_side_data(packet);
+    return true;
+}
+
 void Recorder::recorderRescalePacket(AVPacket *packet)
 {
     AVStream *ostream = m_formatCtx->streams[0];
@@ -240,82 +517,133 @@ Recorder::RecorderFormat Recorder::guessRecordFormat(const QString &fileName)
     return Recorder::RECORDER_FORMAT_NULL;
 }
 
-void Recorder::run()
+bool Recorder::writeBatch()
 {
-    qint64 ptsOrigin = AV_NOPTS_VALUE;
-    for (;;) {
+    // bounded, so that the other recorders get their turn
+    static const int s_maxBatch = 32;
+    for (int batch = 0; batch < s_maxBatch; batch++) {
         AVPacket *rec = Q_NULLPTR;
+        bool ended = false;
         {
             QMutexLocker locker(&m_mutex);
-            while (!m_stopped && m_queue.isEmpty()) {
-                m_recvDataCond.wait(&m_mutex);
+            if (m_finished) {
+                break;
             }
-
-            // if stopped is set, continue to process the remaining events (to
-            // finish the recording) before actually stopping
-            if (m_stopped && m_queue.isEmpty()) {
-                AVPacket *last = m_previous;
-                if (last) {
-                    last->pts -= ptsOrigin;
-                    last->dts = last->pts;
-                    // assign an arbitrary duration to the last packet
-                    last->duration = 100000;
-                    bool ok = write(last);
-                    if (!ok) {
-                        // failing to write the last frame is not very serious, no
-                        // future frame may depend on it, so the resulting file
-                        // will still be valid
-                        qWarning("Could not record last packet");
-                    }
-                    packetDelete(last);
+            if (m_queue.isEmpty()) {
+                if (!m_stopped) {
+                    break;
                 }
-                break;
+                // stopped once the remaining packets were processed (to
+                // finish the recording), push() accepts nothing anymore
+                rec = m_previous;
+                m_previous = Q_NULLPTR;
+                ended = true;
+            } else {
+                rec = m_queue.dequeue();
+                m_queueBytes -= static_cast<quint64>(rec->size);
+                m_queueSpaceCond.wakeOne();
             }
-
-            rec = m_queue.dequeue();
-        }
-
-        // recorder->previous is only written from this thread, no need to lock
-        AVPacket *previous = m_previous;
-        m_previous = rec;
-
-        if (!previous) {
-            // we just received the first packet
-            continue;
         }
 
-        // config packets have no PTS, we must ignore them
-        if (rec->pts != AV_NOPTS_VALUE && previous->pts != AV_NOPTS_VALUE) {
-            // we now know the duration of the previous packet
-            previous->duration = rec->pts - previous->pts;
+        if (ended) {
+            // the write may stall on a slow disk, never with the lock held
+            writeLastPacket(rec);
+            QMutexLocker locker(&m_mutex);
+            m_finished = true;
+            m_finishedCond.wakeAll();
+            qDebug("Recorder ended");
+            break;
         }
 
-        if (previous->pts != AV_NOPTS_VALUE) {
-            if (ptsOrigin == AV_NOPTS_VALUE) {
-                ptsOrigin = previous->pts;
-            }
-            previous->pts -= ptsOrigin;
-            previous->dts = previous->pts;
-        }        
-
-        bool ok = write(previous);
-        packetDelete(previous);
-        if (!ok) {
+        if (!writePacket(rec)) {
             qCritical("Could not record packet");
             QMutexLocker locker(&m_mutex);
             m_failed = true;
+            m_finished = true;
             // discard pending packets
             queueClear();
-            break;
         }
     }
 
-    qDebug("Recorder thread ended");
+    if (m_segmented && m_formatCtx) {
+        // what was muxed reaches the file after each batch, not on
+        // av_write_trailer()
+        avio_flush(m_formatCtx->pb);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_finished && (!m_queue.isEmpty() || m_stopped)) {
+        // still scheduled
+        return true;
+    }
+    m_scheduled = false;
+    m_finishedCond.wakeAll();
+    return false;
+}
+
+bool Recorder::writePacket(AVPacket *rec)
+{
+    // "previous" is only written from the writer, no need to lock
+    AVPacket *previous = m_previous;
+    m_previous = rec;
+
+    if (!previous) {
+        // we just received the first packet
+        return true;
+    }
+
+    // config packets have no PTS, we must ignore them
+    if (rec->pts != AV_NOPTS_VALUE && previous->pts != AV_NOPTS_VALUE) {
+        // we now know the duration of the previous packet
+        previous->duration = rec->pts - previous->pts;
+    }
+
+    if (previous->pts != AV_NOPTS_VALUE) {
+        if (m_ptsOrigin == AV_NOPTS_VALUE) {
+            m_ptsOrigin = previous->pts;
+        }
+        previous->pts -= m_ptsOrigin;
+        previous->dts = previous->pts;
+    }
+
+    bool ok = write(previous);
+    packetDelete(previous);
+    if (!ok) {
+        packetDelete(m_previous);
+        m_previous = Q_NULLPTR;
+    }
+    return ok;
+}
+
+void Recorder::writeLastPacket(AVPacket *last)
+{
+    if (!last) {
+        return;
+    }
+    if (last->pts != AV_NOPTS_VALUE) {
+        last->pts -= m_ptsOrigin;
+        last->dts = last->pts;
+        // assign an arbitrary duration to the last packet
+        last->duration = 100000;
+        bool ok = write(last);
+        if (!ok) {
+            // failing to write the last frame is not very serious, no
+            // future frame may depend on it, so the resulting file
+            // will still be valid
+            qWarning("Could not record last packet");
+        }
+    }
+    packetDelete(last);
 }
 
 bool Recorder::startRecorder()
 {
-    start();
+    QMutexLocker locker(&m_mutex);
+    m_running = true;
+    // the packets pushed before
+    if (!m_queue.isEmpty()) {
+        scheduleLocked();
+    }
     return true;
 }
 
@@ -323,23 +651,161 @@ void Recorder::stopRecorder()
 {
     QMutexLocker locker(&m_mutex);
     m_stopped = true;
-    m_recvDataCond.wakeOne();
+    m_queueSpaceCond.wakeAll();
+    scheduleLocked();
+}
+
+void Recorder::waitRecorder()
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_scheduled) {
+        m_finishedCond.wait(&m_mutex);
+    }
+}
+
+bool Recorder::isRunning()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_running && !m_finished;
 }
 
 bool Recorder::push(const AVPacket *packet)
 {
     QMutexLocker locker(&m_mutex);
-    Q_ASSERT(!m_stopped);
+    if (m_stopped) {
+        // stopped from another thread meanwhile, the recording is over
+        return true;
+    }
 
     if (m_failed) {
         // reject any new packet (this will stop the stream)
         return false;
     }
 
+    // config packets are tiny and required by the header, never dropped
+    if (packet->pts != AV_NOPTS_VALUE) {
+        bool isKeyFrame = packet->flags & AV_PKT_FLAG_KEY;
+        if (m_waitFirstKeyFrame) {
+            if (!isKeyFrame) {
+                return true;
+            }
+            m_waitFirstKeyFrame = false;
+        }
+        if (m_waitKeyFrame) {
+            if (!isKeyFrame) {
+                dropPacket(packet);
+                return true;
+            }
+            m_waitKeyFrame = false;
+        }
+
+        if (queueFull(packet)) {
+            switch (m_queuePolicy) {
+            case QUEUE_POLICY_BLOCK:
+                while (queueFull(packet) && !m_failed && !m_stopped) {
+                    m_queueSpaceCond.wait(&m_mutex);
+                }
+                if (m_failed) {
+                    return false;
+                }
+                if (m_stopped) {
+                    return true;
+                }
+                break;
+            case QUEUE_POLICY_DROP_NON_REF:
+                if (isNonRef(packet)) {
+                    dropPacket(packet);
+                    return true;
+                }
+                dropQueuedNonRef();
+                if (!queueFull(packet)) {
+                    break;
+                }
+                // only reference frames are left
+                Q_FALLTHROUGH();
+            case QUEUE_POLICY_DROP_TO_KEY_FRAME:
+                qWarning("Recorder queue full (%llu bytes), packets dropped until a key frame", m_queueBytes);
+                dropPacket(packet);
+                m_waitKeyFrame = true;
+                return true;
+            }
+        }
+    }
+
     AVPacket *rec = packetNew(packet);
     if (rec) {
-        m_queue.enqueue(rec);
-        m_recvDataCond.wakeOne();
+        queuePacket(rec);
     }
     return rec != Q_NULLPTR;
 }
+
+bool Recorder::preroll(const AVPacket *packet)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_stopped || m_failed) {
+        return false;
+    }
+    if (packet->pts != AV_NOPTS_VALUE && m_waitFirstKeyFrame) {
+        if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+            return true;
+        }
+        m_waitFirstKeyFrame = false;
+    }
+
+    // counted in the queue, but never blocks nor drops: the live packets
+    // wait for it in push()
+    AVPacket *rec = packetNew(packet);
+    if (rec) {
+        queuePacket(rec);
+    }
+    return rec != Q_NULLPTR;
+}
+
+bool Recorder::pushConfig(const QByteArray &config)
+{
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        return false;
+    }
+    if (av_new_packet(packet, config.size())) {
+        av_packet_free(&packet);
+        return false;
+    }
+    memcpy(packet->data, config.constData(), static_cast<size_t>(config.size()));
+    packet->pts = AV_NOPTS_VALUE;
+    packet->dts = AV_NOPTS_VALUE;
+    bool ok = push(packet);
+    av_packet_free(&packet);
+    return ok;
+}
+
+void Recorder::setQueueLimit(quint64 maxBytes, Recorder::QueuePolicy policy)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxQueueBytes = maxBytes;
+    m_queuePolicy = policy;
+}
+
+quint64 Recorder::queueBytes()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queueBytes;
+}
+
+quint64 Recorder::queuePeakBytes()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queuePeakBytes;
+}
+
+quint32 Recorder::queuePeak()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queuePeak;
+}
+
+quint64 Recorder::droppedPackets()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_droppedPackets;
+}
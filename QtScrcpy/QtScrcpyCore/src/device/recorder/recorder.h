@@ -1,10 +1,12 @@
 #ifndef RECORDER_H
 #define RECORDER_H
+#include <QByteArray>
+#include <QFile>
 #include <QMutex>
 #include <QQueue>
 #include <QSize>
 #include <QString>
-#include <QThread>
+#include <QObject>
 #include <QWaitCondition>
 
 extern "C"
@@ -12,7 +14,10 @@ extern "C"
 #include "libavformat/avformat.h"
 }
 
-class Recorder : public QThread
+class QJsonObject;
+// Muxes the packets of a device into a file. push() queues the packets,
+// they are written by the shared RecorderService writers.
+class Recorder : public QObject
 {
     Q_OBJECT
 public:
@@ -23,6 +28,15 @@ public:
         RECORDER_FORMAT_MKV,
     };
 
+    // what push() does when the queue is over its byte budget (the disk
+    // cannot keep up), config packets are always queued
+    enum QueuePolicy
+    {
+        QUEUE_POLICY_BLOCK = 0,         // wait for the writer, the stream (and the display) stalls
+        QUEUE_POLICY_DROP_NON_REF,      // drop the frames no other frame depends on, then as below
+        QUEUE_POLICY_DROP_TO_KEY_FRAME, // drop everything until a key frame fits
+    };
+
     Recorder(const QString &fileName, QObject *parent = Q_NULLPTR);
     virtual ~Recorder();
 
@@ -32,12 +46,43 @@ public:
     void close();
     bool write(AVPacket *packet);
     bool startRecorder();
+    // the queued packets are still written, waitRecorder() waits for them
     void stopRecorder();
+    // returns once no writer uses the recorder, close() is safe after it
+    void waitRecorder();
+    // false after a write error too, a writer may still be finishing a batch
+    bool isRunning();
     bool push(const AVPacket *packet);
+    // the first packet when recording from the middle of a stream, the
+    // following packets are skipped until a key frame
+    bool pushConfig(const QByteArray &config);
+    // packets already received before the recording started (the last GOP),
+    // queued without the budget check: never blocks, unlike push()
+    bool preroll(const AVPacket *packet);
+    // crash safe recording, must be called before open(): the mp4 files are
+    // fragmented at each key frame, the packets are flushed after each write
+    // batch, and a new file is started at the first key frame past
+    // maxDurationUs or maxBytes (0: no limit). The segments and their key frames are listed
+    // in a sidecar index, one json object per line
+    void setSegmented(bool segmented, qint64 maxDurationUs, qint64 maxBytes);
+    // must be called before startRecorder(), maxBytes 0: unbounded
+    void setQueueLimit(quint64 maxBytes, Recorder::QueuePolicy policy);
+
+    quint64 queueBytes();
+    quint64 queuePeakBytes();
+    quint32 queuePeak();
+    quint64 droppedPackets();
 
 private:
     const AVOutputFormat *findMuxer(const char *name);
-    bool recorderWriteHeader(const AVPacket *packet);
+    bool openOutput(const QString &fileName);
+    bool closeOutput();
+    bool recorderWriteHeader(const QByteArray &config);
+    bool segmentFull(const AVPacket *packet);
+    bool nextSegment(qint64 startUs);
+    QString segmentFileName(int segment);
+    void writeIndex(const QJsonObject &entry);
+    bool recorderInlineConfig(AVPacket *packet);
     void recorderRescalePacket(AVPacket *packet);
     QString recorderGetFormatName(Recorder::RecorderFormat format);
     RecorderFormat guessRecordFormat(const QString &fileName);
@@ -46,26 +91,66 @@ private:
     AVPacket *packetNew(const AVPacket *packet);
     void packetDelete(AVPacket *packet);
     void queueClear();
+    bool queueFull(const AVPacket *packet);
+    void queuePacket(AVPacket *packet);
+    void dropPacket(const AVPacket *packet);
+    void dropQueuedNonRef();
+    static bool isNonRef(const AVPacket *packet);
 
-protected:
-    void run();
+    friend class RecorderTask;
+    // on a writer of the RecorderService, true when more packets are queued
+    bool writeBatch();
+    bool writePacket(AVPacket *rec);
+    void writeLastPacket(AVPacket *last);
+    void scheduleLocked();
 
 private:
     QString m_fileName = "";
+    // the file being written, a segment of m_fileName when segmented
+    QString m_outputFileName = "";
     AVFormatContext *m_formatCtx = Q_NULLPTR;
     QSize m_declaredFrameSize;
     bool m_headerWritten = false;
     RecorderFormat m_format = RECORDER_FORMAT_NULL;
+    // the config of the following packets, in the header of a new segment
+    QByteArray m_config;
+    bool m_segmented = false;
+    qint64 m_maxSegmentDurationUs = 0;
+    qint64 m_maxSegmentBytes = 0;
+    int m_segment = 0;
+    qint64 m_segmentStartUs = 0;
+    qint64 m_lastPtsUs = 0;
+    QFile m_indexFile;
     QMutex m_mutex;
-    QWaitCondition m_recvDataCond;
+    bool m_running = false;
     bool m_stopped = false; // set on recorder_stop() by the stream reader
     bool m_failed = false;  // set on packet write failure
+    // queued on the RecorderService, at most once
+    bool m_scheduled = false;
+    // the last packet is written, or the writing failed
+    bool m_finished = false;
+    QWaitCondition m_finishedCond;
     QQueue<AVPacket *> m_queue;
+    // signaled when the writer dequeues, for QUEUE_POLICY_BLOCK
+    QWaitCondition m_queueSpaceCond;
+    quint64 m_maxQueueBytes = 0;
+    QueuePolicy m_queuePolicy = QUEUE_POLICY_BLOCK;
+    quint64 m_queueBytes = 0;
+    quint64 m_queuePeakBytes = 0;
+    quint32 m_queuePeak = 0;
+    quint64 m_droppedPackets = 0;
+    // the packets following a dropped reference frame cannot be decoded
+    bool m_waitKeyFrame = false;
+    // nor the ones before the first key frame
+    bool m_waitFirstKeyFrame = true;
+    // config carried by a dropped packet, attached to the next queued one
+    QByteArray m_droppedConfig;
     // we can write a packet only once we received the next one so that we can
     // set its duration (next_pts - current_pts)
-    // "previous" is only accessed from the recorder thread, so it does not
-    // need to be protected by the mutex
+    // "previous" is only accessed from the writer, so it does not need to be
+    // protected by the mutex
     AVPacket *m_previous = Q_NULLPTR;
+    qint64 m_ptsOrigin = AV_NOPTS_VALUE;
 };
 
 #endif // RECORDER_H
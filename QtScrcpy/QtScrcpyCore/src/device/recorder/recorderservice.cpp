@@ -0,0 +1,45 @@
+#include <QRunnable>
+#include <QThread>
+
+#include "recorder.h"
+#include "recorderservice.h"
+
+class RecorderTask : public QRunnable
+{
+public:
+    explicit RecorderTask(Recorder *recorder) : m_recorder(recorder) {}
+
+    void run() override
+    {
+        // a scheduled recorder is not destroyed before its last batch
+        if (m_recorder->writeBatch()) {
+            RecorderService::getInstance().schedule(m_recorder);
+        }
+    }
+
+private:
+    Recorder *m_recorder;
+};
+
+RecorderService &RecorderService::getInstance()
+{
+    static RecorderService service;
+    return service;
+}
+
+RecorderService::RecorderService()
+{
+    // muxing is cheap, the writers mostly wait for the disks
+    m_pool.setMaxThreadCount(qBound(2, QThread::idealThreadCount() / 2, 8));
+    m_pool.setExpiryTimeout(-1);
+}
+
+RecorderService::~RecorderService()
+{
+    m_pool.waitForDone();
+}
+
+void RecorderService::schedule(Recorder *recorder)
+{
+    m_pool.start(new RecorderTask(recorder));
+}
@@ -0,0 +1,29 @@
+#ifndef RECORDERSERVICE_H
+#define RECORDERSERVICE_H
+
+#include <QThreadPool>
+
+class Recorder;
+
+// The writer threads shared by all the recorders of the process.
+// A recorder with queued packets is scheduled on the pool, its writer drains
+// a batch of packets then schedules it again behind the other recorders, so
+// a recorder is only written by one thread at a time (its packets stay in
+// order) and the threads follow the disks instead of the devices.
+class RecorderService
+{
+public:
+    static RecorderService &getInstance();
+
+    // called by the recorder when it has work and is not scheduled yet
+    void schedule(Recorder *recorder);
+
+private:
+    RecorderService();
+    ~RecorderService();
+
+private:
+    QThreadPool m_pool;
+};
+
+#endif // RECORDERSERVICE_H
@@ -0,0 +1,201 @@
+#include <QDebug>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "recorder.h"
+#include "replaybuffer.h"
+
+// Writes a copy of the buffer with a Recorder, on a worker thread.
+class ReplayTask : public QRunnable
+{
+public:
+    ReplayTask(const QString &fileName, const QSize &frameSize, const QList<AVPacket *> &packets)
+        : m_fileName(fileName)
+        , m_frameSize(frameSize)
+        , m_packets(packets)
+    {}
+
+    ~ReplayTask()
+    {
+        for (AVPacket *packet : m_packets) {
+            av_packet_free(&packet);
+        }
+    }
+
+    void run() override
+    {
+        Recorder recorder(m_fileName);
+        recorder.setFrameSize(m_frameSize);
+        if (!recorder.open()) {
+            qCritical() << QString("Could not save replay %1").arg(m_fileName).toUtf8().toStdString().c_str();
+            return;
+        }
+        recorder.startRecorder();
+        for (const AVPacket *packet : m_packets) {
+            if (!recorder.push(packet)) {
+                break;
+            }
+        }
+        recorder.stopRecorder();
+        recorder.waitRecorder();
+        recorder.close();
+    }
+
+private:
+    QString m_fileName;
+    QSize m_frameSize;
+    QList<AVPacket *> m_packets;
+};
+
+ReplayBuffer::ReplayBuffer(qint64 maxDurationUs, quint64 maxBytes) : m_maxDurationUs(maxDurationUs), m_maxBytes(maxBytes) {}
+
+ReplayBuffer::~ReplayBuffer()
+{
+    while (!m_entries.isEmpty()) {
+        Entry entry = m_entries.dequeue();
+        av_packet_free(&entry.packet);
+    }
+}
+
+void ReplayBuffer::setFrameSize(const QSize &frameSize)
+{
+    QMutexLocker locker(&m_mutex);
+    m_frameSize = frameSize;
+}
+
+void ReplayBuffer::push(const AVPacket *packet)
+{
+    QMutexLocker locker(&m_mutex);
+    if (packet->pts == AV_NOPTS_VALUE) {
+        m_config = QByteArray(reinterpret_cast<const char *>(packet->data), packet->size);
+        return;
+    }
+
+    bool isKeyFrame = packet->flags & AV_PKT_FLAG_KEY;
+    if (m_entries.isEmpty() && !isKeyFrame) {
+        // nothing could decode it
+        return;
+    }
+
+    Entry entry;
+    entry.packet = av_packet_alloc();
+    if (!entry.packet) {
+        return;
+    }
+    // the payload is refcounted, no copy here
+    if (av_packet_ref(entry.packet, packet)) {
+        av_packet_free(&entry.packet);
+        return;
+    }
+    if (isKeyFrame) {
+        entry.config = m_config;
+    }
+    m_entries.enqueue(entry);
+    m_bytes += static_cast<quint64>(packet->size);
+    trim();
+}
+
+bool ReplayBuffer::nextKeyFrame(int &index)
+{
+    for (int i = 1; i < m_entries.size(); i++) {
+        if (m_entries.at(i).packet->flags & AV_PKT_FLAG_KEY) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ReplayBuffer::trim()
+{
+    int keyFrame = 0;
+    while ((m_entries.last().packet->pts - m_entries.first().packet->pts > m_maxDurationUs || m_bytes > m_maxBytes) && nextKeyFrame(keyFrame)) {
+        // the oldest GOP, up to the next key frame
+        for (int i = 0; i < keyFrame; i++) {
+            Entry entry = m_entries.dequeue();
+            m_bytes -= static_cast<quint64>(entry.packet->size);
+            av_packet_free(&entry.packet);
+        }
+    }
+}
+
+bool ReplayBuffer::save(const QString &fileName)
+{
+    QList<AVPacket *> packets;
+    QSize frameSize;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_entries.isEmpty() || m_entries.first().config.isEmpty()) {
+            return false;
+        }
+        frameSize = m_frameSize;
+
+        // the recorder expects the config first
+        const QByteArray &config = m_entries.first().config;
+        AVPacket *configPacket = av_packet_alloc();
+        if (!configPacket || av_new_packet(configPacket, config.size())) {
+            av_packet_free(&configPacket);
+            return false;
+        }
+        memcpy(configPacket->data, config.constData(), static_cast<size_t>(config.size()));
+        configPacket->pts = AV_NOPTS_VALUE;
+        configPacket->dts = AV_NOPTS_VALUE;
+        packets.append(configPacket);
+
+        for (const Entry &entry : m_entries) {
+            AVPacket *packet = av_packet_alloc();
+            if (!packet) {
+                break;
+            }
+            if (av_packet_ref(packet, entry.packet)) {
+                av_packet_free(&packet);
+                break;
+            }
+            packets.append(packet);
+        }
+    }
+
+    QThreadPool::globalInstance()->start(new ReplayTask(fileName, frameSize, packets));
+    return true;
+}
+
+QList<AVPacket *> ReplayBuffer::lastGop(QByteArray &config)
+{
+    QList<AVPacket *> packets;
+    QMutexLocker locker(&m_mutex);
+    int keyFrame = m_entries.size() - 1;
+    while (keyFrame >= 0 && !(m_entries.at(keyFrame).packet->flags & AV_PKT_FLAG_KEY)) {
+        keyFrame--;
+    }
+    if (keyFrame < 0) {
+        return packets;
+    }
+    config = m_entries.at(keyFrame).config;
+    for (int i = keyFrame; i < m_entries.size(); i++) {
+        AVPacket *packet = av_packet_alloc();
+        if (!packet) {
+            break;
+        }
+        if (av_packet_ref(packet, m_entries.at(i).packet)) {
+            av_packet_free(&packet);
+            break;
+        }
+        packets.append(packet);
+    }
+    return packets;
+}
+
+qint64 ReplayBuffer::bufferedDurationUs()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_entries.isEmpty()) {
+        return 0;
+    }
+    return m_entries.last().packet->pts - m_entries.first().packet->pts;
+}
+
+quint64 ReplayBuffer::bufferedBytes()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytes;
+}
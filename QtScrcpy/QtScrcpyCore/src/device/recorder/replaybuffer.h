@@ -0,0 +1,62 @@
+#ifndef REPLAYBUFFER_H
+#define REPLAYBUFFER_H
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QSize>
+#include <QString>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+}
+
+// Keeps the last encoded packets of a device in memory, so that the moments
+// before an incident can be saved without recording everything.
+// The buffer always starts at a key frame: the oldest GOPs are dropped as a
+// whole when it is over maxDurationUs or maxBytes, the last GOP is kept.
+// The packets are refcounted, push() only takes a reference.
+class ReplayBuffer
+{
+public:
+    ReplayBuffer(qint64 maxDurationUs, quint64 maxBytes);
+    virtual ~ReplayBuffer();
+
+    void setFrameSize(const QSize &frameSize);
+    // called from the demuxer thread, config packets included
+    void push(const AVPacket *packet);
+    // mux the buffered packets into fileName (mp4 or mkv) on a worker
+    // thread, the buffer keeps going
+    bool save(const QString &fileName);
+    // references on the packets from the last key frame (to be freed by the
+    // caller) and the config they are decoded with
+    QList<AVPacket *> lastGop(QByteArray &config);
+
+    qint64 bufferedDurationUs();
+    quint64 bufferedBytes();
+
+private:
+    struct Entry
+    {
+        AVPacket *packet;
+        // key frames: the config they are decoded with
+        QByteArray config;
+    };
+
+    void trim();
+    bool nextKeyFrame(int &index);
+
+private:
+    qint64 m_maxDurationUs = 0;
+    quint64 m_maxBytes = 0;
+
+    QMutex m_mutex;
+    QSize m_frameSize;
+    QQueue<Entry> m_entries;
+    quint64 m_bytes = 0;
+    // the config of the following packets
+    QByteArray m_config;
+};
+
+#endif // REPLAYBUFFER_H
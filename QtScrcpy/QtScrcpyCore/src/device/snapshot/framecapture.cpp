@@ -0,0 +1,191 @@
+#include <QDebug>
+#include <QDir>
+#include <QMutexLocker>
+#include <QThread>
+
+#include "framecapture.h"
+#include "frameconverter.h"
+#include "snapshottask.h"
+
+class CaptureTask : public SnapshotTask
+{
+public:
+    CaptureTask(FrameCapture *capture, QSharedPointer<FrameConverter> converter, const qsc::VideoFrame &frame, const QString &filePath,
+                const QString &format, int quality)
+        : SnapshotTask(converter, frame, filePath, format, quality)
+        , m_capture(capture)
+    {}
+
+    void run() override
+    {
+        // the capture waits for its pool when destroyed, so it outlives the task
+        m_capture->taskDone(save());
+    }
+
+private:
+    FrameCapture *m_capture;
+};
+
+FrameCapture::FrameCapture(const QString &serial) : m_serial(serial)
+{
+    memset(m_signature, 0, sizeof(m_signature));
+}
+
+FrameCapture::~FrameCapture()
+{
+    stop();
+    m_pool.waitForDone();
+}
+
+bool FrameCapture::start(const qsc::CaptureParams &params, const QString &defaultPath)
+{
+    QString path = params.savePath.isEmpty() ? defaultPath : params.savePath;
+    if (path.isEmpty()) {
+        qWarning() << "please select capture save path!!!";
+        return false;
+    }
+    if (!QDir().mkpath(path)) {
+        qWarning() << "capture save path is not writable" << path;
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_params = params;
+    m_params.intervalMs = qMax(1u, m_params.intervalMs);
+    m_params.everyNthFrame = qMax(1u, m_params.everyNthFrame);
+    m_params.sceneThreshold = qBound(1, m_params.sceneThreshold, 255);
+    m_params.maxPending = qMax(1, m_params.maxPending);
+    m_params.format = SnapshotTask::fileSuffix(m_params.format);
+    m_path = path;
+
+    int threads = m_params.threads;
+    if (threads <= 0) {
+        // leave cores to the decoder and the renderer
+        threads = qBound(1, QThread::idealThreadCount() / 2, 4);
+    }
+    m_pool.setMaxThreadCount(threads);
+    if (!m_converter) {
+        m_converter.reset(new FrameConverter());
+    }
+
+    m_frameCount = 0;
+    m_lastCaptureMs = -1;
+    m_hasSignature = false;
+    m_timer.start();
+    m_capturing = true;
+    qInfo() << "capture start, save to" << m_path;
+    return true;
+}
+
+void FrameCapture::stop()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_capturing) {
+        return;
+    }
+    // the captures in progress still complete
+    m_capturing = false;
+    qInfo() << "capture stop, captured:" << m_captured << "dropped:" << m_dropped;
+}
+
+bool FrameCapture::isCapturing()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_capturing;
+}
+
+void FrameCapture::push(const qsc::VideoFrame &frame)
+{
+    if (frame.isNull()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_capturing || !sample(frame)) {
+        return;
+    }
+
+    if (m_pending >= static_cast<quint32>(m_params.maxPending)) {
+        // never slow down the video pipeline
+        m_dropped++;
+        return;
+    }
+
+    QString fileName = QString("%1_%2.%3").arg(m_serial).arg(m_sequence++, 8, 10, QChar('0')).arg(m_params.format);
+    fileName.replace(":", "_");
+    QString filePath = QDir(m_path).absoluteFilePath(fileName);
+
+    m_pending++;
+    m_pool.start(new CaptureTask(this, m_converter, frame, filePath, m_params.format, m_params.quality));
+}
+
+quint64 FrameCapture::captured() const
+{
+    return m_captured;
+}
+
+quint64 FrameCapture::dropped() const
+{
+    return m_dropped;
+}
+
+quint32 FrameCapture::pending() const
+{
+    return m_pending;
+}
+
+bool FrameCapture::sample(const qsc::VideoFrame &frame)
+{
+    quint64 frameIndex = m_frameCount++;
+    switch (m_params.mode) {
+    case qsc::CaptureParams::MODE_EVERY_NTH_FRAME:
+        return frameIndex % m_params.everyNthFrame == 0;
+    case qsc::CaptureParams::MODE_SCENE_CHANGE:
+        return sceneChanged(frame);
+    case qsc::CaptureParams::MODE_INTERVAL:
+    default: {
+        qint64 now = m_timer.elapsed();
+        if (m_lastCaptureMs >= 0 && now - m_lastCaptureMs < m_params.intervalMs) {
+            return false;
+        }
+        m_lastCaptureMs = now;
+        return true;
+    }
+    }
+}
+
+bool FrameCapture::sceneChanged(const qsc::VideoFrame &frame)
+{
+    // compare a sparse grid of luma samples with the last captured frame
+    quint8 signature[s_signatureWidth * s_signatureHeight];
+    const uint8_t *luma = frame.data(0);
+    int linesize = frame.linesize(0);
+    int width = frame.width();
+    int height = frame.height();
+    quint32 diff = 0;
+    for (int y = 0; y < s_signatureHeight; y++) {
+        const uint8_t *line = luma + ((2 * y + 1) * height / (2 * s_signatureHeight)) * linesize;
+        for (int x = 0; x < s_signatureWidth; x++) {
+            int i = y * s_signatureWidth + x;
+            signature[i] = line[(2 * x + 1) * width / (2 * s_signatureWidth)];
+            diff += qAbs(signature[i] - m_signature[i]);
+        }
+    }
+
+    if (m_hasSignature && diff < static_cast<quint32>(m_params.sceneThreshold) * sizeof(signature)) {
+        return false;
+    }
+    memcpy(m_signature, signature, sizeof(m_signature));
+    m_hasSignature = true;
+    return true;
+}
+
+void FrameCapture::taskDone(bool success)
+{
+    if (success) {
+        m_captured++;
+    } else {
+        m_dropped++;
+    }
+    m_pending--;
+}
@@ -0,0 +1,69 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <atomic>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+
+#include "QtScrcpyCoreDef.h"
+#include "videoframe.h"
+
+class FrameConverter;
+
+// Periodic / burst capture of the decoded frames.
+// push() is called on the decoder thread for every decoded frame, before
+// the renderer may skip it: it only samples and hands a reference on the
+// frame to a worker pool, when too many captures are still being saved the
+// frame is dropped instead of waiting.
+class FrameCapture
+{
+public:
+    explicit FrameCapture(const QString &serial);
+    virtual ~FrameCapture();
+
+    bool start(const qsc::CaptureParams &params, const QString &defaultPath);
+    void stop();
+    bool isCapturing();
+
+    void push(const qsc::VideoFrame &frame);
+
+    quint64 captured() const;
+    quint64 dropped() const;
+    quint32 pending() const;
+
+private:
+    friend class CaptureTask;
+
+    bool sample(const qsc::VideoFrame &frame);
+    bool sceneChanged(const qsc::VideoFrame &frame);
+    void taskDone(bool success);
+
+private:
+    // luma samples compared for scene changes
+    static const int s_signatureWidth = 32;
+    static const int s_signatureHeight = 18;
+
+    QString m_serial;
+    QThreadPool m_pool;
+    QSharedPointer<FrameConverter> m_converter;
+
+    QMutex m_mutex;
+    bool m_capturing = false;
+    qsc::CaptureParams m_params;
+    QString m_path;
+    quint64 m_frameCount = 0;
+    quint64 m_sequence = 0;
+    QElapsedTimer m_timer;
+    qint64 m_lastCaptureMs = -1;
+    quint8 m_signature[s_signatureWidth * s_signatureHeight];
+    bool m_hasSignature = false;
+
+    std::atomic<quint64> m_captured { 0 };
+    std::atomic<quint64> m_dropped { 0 };
+    std::atomic<quint32> m_pending { 0 };
+};
+
+#endif // FRAMECAPTURE_H
@@ -0,0 +1,98 @@
+#include <QDebug>
+
+#include "frameconverter.h"
+extern "C"
+{
+#include "libavutil/imgutils.h"
+}
+
+static void imageCleanup(void *info)
+{
+    AVBufferRef *buffer = static_cast<AVBufferRef *>(info);
+    av_buffer_unref(&buffer);
+}
+
+FrameConverter::FrameConverter() {}
+
+FrameConverter::~FrameConverter()
+{
+    deInit();
+}
+
+QImage FrameConverter::toImage(const qsc::VideoFrame &frame)
+{
+    const AVFrame *srcFrame = frame.avFrame();
+    if (!srcFrame || srcFrame->width <= 0 || srcFrame->height <= 0) {
+        return QImage();
+    }
+
+    // a single conversion context, the conversions are serialized
+    QMutexLocker locker(&m_mutex);
+    if (!prepare(srcFrame->width, srcFrame->height, static_cast<AVPixelFormat>(srcFrame->format))) {
+        return QImage();
+    }
+
+    AVBufferRef *buffer = av_buffer_pool_get(m_pool);
+    if (!buffer) {
+        qCritical("Could not allocate screenshot buffer");
+        return QImage();
+    }
+
+    AVFrame *rgbFrame = av_frame_alloc();
+    if (!rgbFrame) {
+        av_buffer_unref(&buffer);
+        return QImage();
+    }
+    av_image_fill_arrays(rgbFrame->data, rgbFrame->linesize, buffer->data, AV_PIX_FMT_RGB32, m_width, m_height, 1);
+    bool ok = m_convert.convert(srcFrame, rgbFrame);
+    int bytesPerLine = rgbFrame->linesize[0];
+    av_frame_free(&rgbFrame);
+    if (!ok) {
+        av_buffer_unref(&buffer);
+        return QImage();
+    }
+
+    // the image owns the buffer reference from now on
+    return QImage(buffer->data, m_width, m_height, bytesPerLine, QImage::Format_RGB32, imageCleanup, buffer);
+}
+
+bool FrameConverter::prepare(int width, int height, AVPixelFormat format)
+{
+    if (m_convert.isInit() && m_width == width && m_height == height && m_format == format) {
+        return true;
+    }
+
+    // the frame size changed (rotation), start again
+    deInit();
+
+    int size = av_image_get_buffer_size(AV_PIX_FMT_RGB32, width, height, 1);
+    if (size <= 0) {
+        return false;
+    }
+    m_pool = av_buffer_pool_init(size, av_buffer_alloc);
+    if (!m_pool) {
+        return false;
+    }
+
+    m_convert.setSrcFrameInfo(width, height, format);
+    m_convert.setDstFrameInfo(width, height, AV_PIX_FMT_RGB32);
+    if (!m_convert.init()) {
+        deInit();
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_format = format;
+    return true;
+}
+
+void FrameConverter::deInit()
+{
+    m_convert.deInit();
+    // buffers still held by images are freed with them
+    av_buffer_pool_uninit(&m_pool);
+    m_width = 0;
+    m_height = 0;
+    m_format = AV_PIX_FMT_NONE;
+}
@@ -0,0 +1,42 @@
+#ifndef FRAMECONVERTER_H
+#define FRAMECONVERTER_H
+
+#include <QImage>
+#include <QMutex>
+
+extern "C"
+{
+#include "libavutil/buffer.h"
+#include "libavutil/pixfmt.h"
+}
+
+#include "avframeconvert.h"
+#include "videoframe.h"
+
+// Converts decoded frames to RGB32 images for screenshots.
+// The conversion context is kept as long as the frame size and format do not
+// change, and the images are backed by a pool of right-sized buffers which go
+// back to the pool when the image is destroyed.
+// It may be used from any thread.
+class FrameConverter
+{
+public:
+    FrameConverter();
+    virtual ~FrameConverter();
+
+    QImage toImage(const qsc::VideoFrame &frame);
+
+private:
+    bool prepare(int width, int height, AVPixelFormat format);
+    void deInit();
+
+private:
+    QMutex m_mutex;
+    AVFrameConvert m_convert;
+    AVBufferPool *m_pool = Q_NULLPTR;
+    int m_width = 0;
+    int m_height = 0;
+    AVPixelFormat m_format = AV_PIX_FMT_NONE;
+};
+
+#endif // FRAMECONVERTER_H
@@ -0,0 +1,374 @@
+#include <cmath>
+#include <cstring>
+
+#include "jpegencoder.h"
+extern "C"
+{
+#include "libavutil/frame.h"
+}
+
+// ITU-T T.81 Annex K tables
+static const quint8 s_zigzag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48,
+    41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+    30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+static const quint8 s_lumaQuant[64] = {
+    16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+    14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+    18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+};
+
+static const quint8 s_chromaQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+static const quint8 s_dcLumaBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const quint8 s_dcChromaBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const quint8 s_dcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const quint8 s_acLumaBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const quint8 s_acLumaValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1,
+    0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56,
+    0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85,
+    0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa,
+    0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6,
+    0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9,
+    0xfa,
+};
+
+static const quint8 s_acChromaBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const quint8 s_acChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42,
+    0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19,
+    0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83,
+    0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8,
+    0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
+    0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9,
+    0xfa,
+};
+
+// scale factors of the AAN forward DCT (IJG jfdctflt.c)
+static const float s_aanScale[8] = { 1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f };
+
+JpegEncoder::JpegEncoder()
+{
+    buildHuffmanTable(s_dcLumaBits, s_dcValues, m_huffman[0]);
+    buildHuffmanTable(s_acLumaBits, s_acLumaValues, m_huffman[1]);
+    buildHuffmanTable(s_dcChromaBits, s_dcValues, m_huffman[2]);
+    buildHuffmanTable(s_acChromaBits, s_acChromaValues, m_huffman[3]);
+    initQuantTables();
+}
+
+JpegEncoder::~JpegEncoder() {}
+
+void JpegEncoder::setQuality(int quality)
+{
+    m_quality = qBound(1, quality, 100);
+    initQuantTables();
+}
+
+bool JpegEncoder::encode(const AVFrame *frame, QByteArray &jpeg)
+{
+    if (!frame || frame->width <= 0 || frame->height <= 0 || frame->width > 65535 || frame->height > 65535) {
+        return false;
+    }
+    if (frame->format != AV_PIX_FMT_YUV420P && frame->format != AV_PIX_FMT_YUVJ420P) {
+        return false;
+    }
+
+    bool limitedRange = frame->format == AV_PIX_FMT_YUV420P && frame->color_range != AVCOL_RANGE_JPEG;
+    for (int i = 0; i < 256; i++) {
+        if (limitedRange) {
+            m_lumaRange[i] = static_cast<quint8>(qBound(0, qRound((i - 16) * 255.0 / 219.0), 255));
+            m_chromaRange[i] = static_cast<quint8>(qBound(0, qRound((i - 128) * 255.0 / 224.0 + 128), 255));
+        } else {
+            m_lumaRange[i] = static_cast<quint8>(i);
+            m_chromaRange[i] = static_cast<quint8>(i);
+        }
+    }
+
+    int width = frame->width;
+    int height = frame->height;
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+
+    jpeg.clear();
+    // most screenshots compress to less than 1 bit per pixel
+    jpeg.reserve(width * height / 8);
+    m_out = &jpeg;
+    m_bitBuffer = 0;
+    m_bitCount = 0;
+
+    writeHeaders(width, height);
+
+    float block[64];
+    int lastDc[3] = { 0, 0, 0 };
+    for (int mcuY = 0; mcuY < height; mcuY += 16) {
+        for (int mcuX = 0; mcuX < width; mcuX += 16) {
+            // 4 luma blocks, the pixels outside of the frame repeat the edges
+            for (int i = 0; i < 4; i++) {
+                int blockX = mcuX + (i & 1) * 8;
+                int blockY = mcuY + (i >> 1) * 8;
+                for (int y = 0; y < 8; y++) {
+                    const quint8 *line = frame->data[0] + qMin(blockY + y, height - 1) * frame->linesize[0];
+                    for (int x = 0; x < 8; x++) {
+                        block[y * 8 + x] = m_lumaRange[line[qMin(blockX + x, width - 1)]] - 128.0f;
+                    }
+                }
+                encodeBlock(block, m_divisors[0], lastDc[0], m_huffman[0], m_huffman[1]);
+            }
+
+            // 1 block per chroma plane
+            for (int plane = 1; plane <= 2; plane++) {
+                int blockX = mcuX / 2;
+                int blockY = mcuY / 2;
+                for (int y = 0; y < 8; y++) {
+                    const quint8 *line = frame->data[plane] + qMin(blockY + y, chromaHeight - 1) * frame->linesize[plane];
+                    for (int x = 0; x < 8; x++) {
+                        block[y * 8 + x] = m_chromaRange[line[qMin(blockX + x, chromaWidth - 1)]] - 128.0f;
+                    }
+                }
+                encodeBlock(block, m_divisors[1], lastDc[plane], m_huffman[2], m_huffman[3]);
+            }
+        }
+    }
+
+    flushBits();
+    // EOI
+    m_out->append(static_cast<char>(0xFF));
+    m_out->append(static_cast<char>(0xD9));
+    m_out = Q_NULLPTR;
+    return true;
+}
+
+void JpegEncoder::initQuantTables()
+{
+    // IJG quality scaling
+    int scale = m_quality < 50 ? 5000 / m_quality : 200 - m_quality * 2;
+    for (int i = 0; i < 64; i++) {
+        int luma = qBound(1, (s_lumaQuant[i] * scale + 50) / 100, 255);
+        int chroma = qBound(1, (s_chromaQuant[i] * scale + 50) / 100, 255);
+        int row = i / 8;
+        int col = i % 8;
+        m_divisors[0][i] = 1.0f / (luma * s_aanScale[row] * s_aanScale[col] * 8.0f);
+        m_divisors[1][i] = 1.0f / (chroma * s_aanScale[row] * s_aanScale[col] * 8.0f);
+    }
+    for (int i = 0; i < 64; i++) {
+        int natural = s_zigzag[i];
+        m_quantTables[0][i] = static_cast<quint8>(qBound(1, (s_lumaQuant[natural] * scale + 50) / 100, 255));
+        m_quantTables[1][i] = static_cast<quint8>(qBound(1, (s_chromaQuant[natural] * scale + 50) / 100, 255));
+    }
+}
+
+void JpegEncoder::writeHeaders(int width, int height)
+{
+    // SOI
+    m_out->append(static_cast<char>(0xFF));
+    m_out->append(static_cast<char>(0xD8));
+
+    // APP0: JFIF 1.01, no density, no thumbnail
+    static const quint8 app0[] = { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+    writeMarker(0xE0, app0, sizeof(app0));
+
+    // DQT
+    quint8 dqt[2 * 65];
+    for (int i = 0; i < 2; i++) {
+        dqt[i * 65] = static_cast<quint8>(i);
+        memcpy(dqt + i * 65 + 1, m_quantTables[i], 64);
+    }
+    writeMarker(0xDB, dqt, sizeof(dqt));
+
+    // SOF0: 8 bits, Y 2x2 with table 0, Cb/Cr 1x1 with table 1
+    quint8 sof[] = { 8, static_cast<quint8>(height >> 8), static_cast<quint8>(height & 0xFF), static_cast<quint8>(width >> 8),
+                     static_cast<quint8>(width & 0xFF), 3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 };
+    writeMarker(0xC0, sof, sizeof(sof));
+
+    // DHT
+    struct
+    {
+        quint8 tableClass;
+        const quint8 *bits;
+        const quint8 *values;
+    } dht[] = {
+        { 0x00, s_dcLumaBits, s_dcValues },
+        { 0x10, s_acLumaBits, s_acLumaValues },
+        { 0x01, s_dcChromaBits, s_dcValues },
+        { 0x11, s_acChromaBits, s_acChromaValues },
+    };
+    for (const auto &table : dht) {
+        quint8 data[1 + 16 + 162];
+        int count = 0;
+        data[0] = table.tableClass;
+        for (int i = 0; i < 16; i++) {
+            data[1 + i] = table.bits[i];
+            count += table.bits[i];
+        }
+        memcpy(data + 17, table.values, count);
+        writeMarker(0xC4, data, 17 + count);
+    }
+
+    // SOS
+    static const quint8 sos[] = { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+    writeMarker(0xDA, sos, sizeof(sos));
+}
+
+void JpegEncoder::writeMarker(quint8 marker, const quint8 *data, int size)
+{
+    int length = size + 2;
+    m_out->append(static_cast<char>(0xFF));
+    m_out->append(static_cast<char>(marker));
+    m_out->append(static_cast<char>(length >> 8));
+    m_out->append(static_cast<char>(length & 0xFF));
+    m_out->append(reinterpret_cast<const char *>(data), size);
+}
+
+void JpegEncoder::encodeBlock(float *block, const float *divisors, int &lastDc, const HuffmanTable &dc, const HuffmanTable &ac)
+{
+    forwardDct(block);
+
+    int coefficients[64];
+    for (int i = 0; i < 64; i++) {
+        int natural = s_zigzag[i];
+        coefficients[i] = static_cast<int>(lrintf(block[natural] * divisors[natural]));
+    }
+
+    // DC, as a difference with the previous block of the same component
+    int diff = coefficients[0] - lastDc;
+    lastDc = coefficients[0];
+    int value = diff < 0 ? -diff : diff;
+    int category = 0;
+    while (value) {
+        category++;
+        value >>= 1;
+    }
+    writeBits(dc.codes[category], dc.sizes[category]);
+    if (category) {
+        writeBits(static_cast<quint32>(diff < 0 ? diff - 1 : diff) & ((1u << category) - 1), category);
+    }
+
+    // AC, run-length of zeros
+    int run = 0;
+    for (int i = 1; i < 64; i++) {
+        int coefficient = coefficients[i];
+        if (!coefficient) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            // ZRL
+            writeBits(ac.codes[0xF0], ac.sizes[0xF0]);
+            run -= 16;
+        }
+        value = coefficient < 0 ? -coefficient : coefficient;
+        category = 0;
+        while (value) {
+            category++;
+            value >>= 1;
+        }
+        int symbol = (run << 4) | category;
+        writeBits(ac.codes[symbol], ac.sizes[symbol]);
+        writeBits(static_cast<quint32>(coefficient < 0 ? coefficient - 1 : coefficient) & ((1u << category) - 1), category);
+        run = 0;
+    }
+    if (run) {
+        // EOB
+        writeBits(ac.codes[0x00], ac.sizes[0x00]);
+    }
+}
+
+void JpegEncoder::writeBits(quint32 bits, int size)
+{
+    m_bitBuffer = (m_bitBuffer << size) | bits;
+    m_bitCount += size;
+    while (m_bitCount >= 8) {
+        m_bitCount -= 8;
+        quint8 byte = static_cast<quint8>(m_bitBuffer >> m_bitCount);
+        m_out->append(static_cast<char>(byte));
+        if (byte == 0xFF) {
+            // byte stuffing
+            m_out->append(static_cast<char>(0));
+        }
+    }
+    m_bitBuffer &= (1u << m_bitCount) - 1;
+}
+
+void JpegEncoder::flushBits()
+{
+    if (m_bitCount) {
+        // pad with 1 bits
+        writeBits((1u << (8 - m_bitCount)) - 1, 8 - m_bitCount);
+    }
+}
+
+void JpegEncoder::buildHuffmanTable(const quint8 *bits, const quint8 *values, HuffmanTable &table)
+{
+    // ITU-T T.81 Annex C
+    memset(&table, 0, sizeof(table));
+    quint16 code = 0;
+    int k = 0;
+    for (int size = 1; size <= 16; size++) {
+        for (int i = 0; i < bits[size - 1]; i++) {
+            table.codes[values[k]] = code;
+            table.sizes[values[k]] = static_cast<quint8>(size);
+            code++;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+void JpegEncoder::forwardDct(float *block)
+{
+    // AAN forward DCT (IJG jfdctflt.c), rows then columns, the output is
+    // scaled by s_aanScale, which is compensated in the divisors
+    for (int pass = 0; pass < 2; pass++) {
+        int step = pass ? 8 : 1;
+        int stride = pass ? 1 : 8;
+        for (int i = 0; i < 8; i++) {
+            float *d = block + i * stride;
+            float tmp0 = d[0 * step] + d[7 * step];
+            float tmp7 = d[0 * step] - d[7 * step];
+            float tmp1 = d[1 * step] + d[6 * step];
+            float tmp6 = d[1 * step] - d[6 * step];
+            float tmp2 = d[2 * step] + d[5 * step];
+            float tmp5 = d[2 * step] - d[5 * step];
+            float tmp3 = d[3 * step] + d[4 * step];
+            float tmp4 = d[3 * step] - d[4 * step];
+
+            // even part
+            float tmp10 = tmp0 + tmp3;
+            float tmp13 = tmp0 - tmp3;
+            float tmp11 = tmp1 + tmp2;
+            float tmp12 = tmp1 - tmp2;
+            d[0 * step] = tmp10 + tmp11;
+            d[4 * step] = tmp10 - tmp11;
+            float z1 = (tmp12 + tmp13) * 0.707106781f;
+            d[2 * step] = tmp13 + z1;
+            d[6 * step] = tmp13 - z1;
+
+            // odd part
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+            float z5 = (tmp10 - tmp12) * 0.382683433f;
+            float z2 = 0.541196100f * tmp10 + z5;
+            float z4 = 1.306562965f * tmp12 + z5;
+            float z3 = tmp11 * 0.707106781f;
+            float z11 = tmp7 + z3;
+            float z13 = tmp7 - z3;
+            d[5 * step] = z13 + z2;
+            d[3 * step] = z13 - z2;
+            d[1 * step] = z11 + z4;
+            d[7 * step] = z11 - z4;
+        }
+    }
+}
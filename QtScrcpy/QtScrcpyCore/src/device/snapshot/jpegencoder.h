@@ -0,0 +1,55 @@
+#ifndef JPEGENCODER_H
+#define JPEGENCODER_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+// forward declarations
+typedef struct AVFrame AVFrame;
+
+// Baseline JPEG (JFIF, 4:2:0) encoder working directly on the YUV420P planes
+// of a decoded frame: the chroma planes already have the JPEG 4:2:0 layout,
+// so there is neither RGB conversion nor chroma resampling.
+class JpegEncoder
+{
+public:
+    JpegEncoder();
+    virtual ~JpegEncoder();
+
+    // 1 (smallest) to 100 (best)
+    void setQuality(int quality);
+    bool encode(const AVFrame *frame, QByteArray &jpeg);
+
+private:
+    struct HuffmanTable
+    {
+        quint16 codes[256];
+        quint8 sizes[256];
+    };
+
+    void initQuantTables();
+    void writeHeaders(int width, int height);
+    void writeMarker(quint8 marker, const quint8 *data, int size);
+    void encodeBlock(float *block, const float *divisors, int &lastDc, const HuffmanTable &dc, const HuffmanTable &ac);
+    void writeBits(quint32 bits, int size);
+    void flushBits();
+
+    static void buildHuffmanTable(const quint8 *bits, const quint8 *values, HuffmanTable &table);
+    static void forwardDct(float *block);
+
+private:
+    int m_quality = 90;
+    quint8 m_quantTables[2][64];     // zigzag order, as written in the DQT
+    float m_divisors[2][64];         // natural order, with the AAN DCT scaling
+    HuffmanTable m_huffman[4];       // DC luma, AC luma, DC chroma, AC chroma
+    // expand the limited (video) range of the decoder output to the full
+    // range expected by JFIF
+    quint8 m_lumaRange[256];
+    quint8 m_chromaRange[256];
+
+    QByteArray *m_out = Q_NULLPTR;
+    quint32 m_bitBuffer = 0;
+    int m_bitCount = 0;
+};
+
+#endif // JPEGENCODER_H
@@ -0,0 +1,95 @@
+#include <QDebug>
+#include <QFile>
+#include <QImage>
+#include <QImageWriter>
+
+#include "frameconverter.h"
+#include "jpegencoder.h"
+#include "snapshottask.h"
+
+SnapshotTask::SnapshotTask(QSharedPointer<FrameConverter> converter, const qsc::VideoFrame &frame, const QString &filePath, const QString &format, int quality)
+    : m_converter(converter)
+    , m_frame(frame)
+    , m_filePath(filePath)
+    , m_format(fileSuffix(format))
+    , m_quality(quality)
+{}
+
+SnapshotTask::~SnapshotTask() {}
+
+QString SnapshotTask::fileSuffix(const QString &format)
+{
+    QString suffix = format.toLower();
+    if ("jpeg" == suffix) {
+        return "jpg";
+    }
+    if ("jpg" == suffix) {
+        return suffix;
+    }
+    if ("webp" == suffix && QImageWriter::supportedImageFormats().contains("webp")) {
+        return suffix;
+    }
+    return "png";
+}
+
+void SnapshotTask::run()
+{
+    if (!save()) {
+        return;
+    }
+
+    qInfo() << "screenshot save to " << m_filePath;
+}
+
+bool SnapshotTask::save()
+{
+    bool ret = false;
+    if ("jpg" == m_format) {
+        ret = saveJpeg();
+    } else {
+        ret = saveImage();
+    }
+    // release the decoded frame as soon as possible
+    m_frame = qsc::VideoFrame();
+    return ret;
+}
+
+bool SnapshotTask::saveJpeg()
+{
+    // the decoded planes are already 4:2:0, no RGB intermediate is needed
+    JpegEncoder encoder;
+    encoder.setQuality(m_quality);
+    QByteArray jpeg;
+    if (!encoder.encode(m_frame.avFrame(), jpeg)) {
+        // hardware or unusual pixel formats, go through the RGB converter
+        return saveImage();
+    }
+
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(jpeg) != jpeg.size()) {
+        qWarning() << "screenshot save failed" << m_filePath;
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotTask::saveImage()
+{
+    if (!m_converter) {
+        return false;
+    }
+
+    QImage rgbImage = m_converter->toImage(m_frame);
+    if (rgbImage.isNull()) {
+        qWarning() << "screenshot convert failed";
+        return false;
+    }
+
+    // for png, 100 means no zlib compression: the fastest
+    int quality = "png" == m_format ? 100 : m_quality;
+    if (!rgbImage.save(m_filePath, m_format.toUtf8().constData(), quality)) {
+        qWarning() << "screenshot save failed" << m_filePath;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef SNAPSHOTTASK_H
+#define SNAPSHOTTASK_H
+
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QString>
+
+#include "videoframe.h"
+
+class FrameConverter;
+
+// Converts and saves one frame on a worker thread.
+// It only holds a reference on the frame and on the converter, so it may
+// outlive the device which started it.
+class SnapshotTask : public QRunnable
+{
+public:
+    // format: "png", "jpg" (encoded from the YUV planes) or "webp"
+    SnapshotTask(QSharedPointer<FrameConverter> converter, const qsc::VideoFrame &frame, const QString &filePath,
+                 const QString &format = "png", int quality = 90);
+    virtual ~SnapshotTask();
+
+    // file suffix actually used for the format, webp falls back to png
+    // when the Qt image plugin is missing
+    static QString fileSuffix(const QString &format);
+
+    void run() override;
+    // convert/encode and write the file on the calling thread
+    bool save();
+
+private:
+    bool saveJpeg();
+    bool saveImage();
+
+private:
+    QSharedPointer<FrameConverter> m_converter;
+    qsc::VideoFrame m_frame;
+    QString m_filePath;
+    QString m_format;
+    int m_quality = 90;
+};
+
+#endif // SNAPSHOTTASK_H
@@ -14,6 +14,7 @@
 #include "config.h"
 #include "dialog.h"
 #include "mousetap/mousetap.h"
+#include "renderbenchmark.h"
 
 static Dialog *g_mainDlg = Q_NULLPTR;
 static QtMessageHandler g_oldMessageHandler = Q_NULLPTR;
@@ -68,6 +69,7 @@ int main(int argc, char *argv[])
     } else if (2 == opengl) {
         QApplication::setAttribute(Qt::AA_UseDesktopOpenGL);
     }
+    // 3: rendered with QPainter, see VideoForm::initUI()
 
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
@@ -114,6 +116,12 @@ int main(int argc, char *argv[])
         a.setApplicationVersion(version);
     }
 
+    // headless render benchmark for ci, prints json and exits, e.g.
+    // xvfb-run QtScrcpy --render-benchmark --size 1920x1080 --frames 300
+    if (a.arguments().contains("--render-benchmark")) {
+        return RenderBenchmark::exec(a.arguments());
+    }
+
     installTranslator();
 #if defined(Q_OS_WIN32) || defined(Q_OS_OSX)
     MouseTap::getInstance()->initMouseEventTap();
@@ -0,0 +1,189 @@
+#include <cmath>
+
+#include "devicewall.h"
+#include "yuvtextures.h"
+
+class DeviceWallObserver : public qsc::DeviceObserver
+{
+public:
+    DeviceWallObserver(DeviceWall *wall, const QString &serial) : m_wall(wall), m_serial(serial) {}
+    virtual ~DeviceWallObserver() {}
+
+    void onVideoFrame(const qsc::VideoFrame &frame) override
+    {
+        // main thread, the handle keeps the frame until the next repaint
+        m_wall->pushFrame(m_serial, frame);
+    }
+
+private:
+    DeviceWall *m_wall;
+    QString m_serial;
+};
+
+DeviceWall::DeviceWall(QWidget *parent) : QOpenGLWidget(parent) {}
+
+DeviceWall::~DeviceWall()
+{
+    makeCurrent();
+    for (auto &tile : m_tiles) {
+        tile.textures->deInitialize();
+        delete tile.textures;
+        delete tile.observer;
+    }
+    m_tiles.clear();
+    m_renderer.deInitialize();
+    doneCurrent();
+}
+
+qsc::DeviceObserver *DeviceWall::addDevice(const QString &serial)
+{
+    int index = indexOf(serial);
+    if (index >= 0) {
+        return m_tiles[index].observer;
+    }
+
+    Tile tile;
+    tile.serial = serial;
+    tile.observer = new DeviceWallObserver(this, serial);
+    tile.textures = new YUVTextures();
+    tile.textures->setMipmap(m_mipmap);
+    m_tiles.append(tile);
+    update();
+    return tile.observer;
+}
+
+qsc::DeviceObserver *DeviceWall::observer(const QString &serial)
+{
+    int index = indexOf(serial);
+    if (index < 0) {
+        return Q_NULLPTR;
+    }
+    return m_tiles[index].observer;
+}
+
+void DeviceWall::removeDevice(const QString &serial)
+{
+    int index = indexOf(serial);
+    if (index < 0) {
+        return;
+    }
+
+    Tile tile = m_tiles.takeAt(index);
+    if (m_initialized) {
+        makeCurrent();
+        tile.textures->deInitialize();
+        doneCurrent();
+    }
+    delete tile.textures;
+    delete tile.observer;
+    update();
+}
+
+int DeviceWall::deviceCount() const
+{
+    return m_tiles.size();
+}
+
+void DeviceWall::setMipmap(bool mipmap)
+{
+    m_mipmap = mipmap;
+    for (auto &tile : m_tiles) {
+        tile.textures->setMipmap(mipmap);
+    }
+    update();
+}
+
+void DeviceWall::pushFrame(const QString &serial, const qsc::VideoFrame &frame)
+{
+    int index = indexOf(serial);
+    if (index < 0) {
+        return;
+    }
+    // an older frame not presented yet is dropped
+    m_tiles[index].pendingFrame = frame;
+    // the repaints are coalesced until the next swap
+    update();
+}
+
+void DeviceWall::initializeGL()
+{
+    initializeOpenGLFunctions();
+    glDisable(GL_DEPTH_TEST);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    m_renderer.initialize();
+    m_initialized = true;
+}
+
+void DeviceWall::paintGL()
+{
+    uploadPendingFrames();
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    qreal ratio = devicePixelRatioF();
+    int surfaceHeight = qRound(height() * ratio);
+    for (int i = 0; i < m_tiles.size(); i++) {
+        QRect rect = tileRect(i, m_tiles[i].textures->frameSize());
+        if (rect.isEmpty()) {
+            continue;
+        }
+        // GL viewport origin is bottom left
+        glViewport(qRound(rect.x() * ratio), surfaceHeight - qRound((rect.y() + rect.height()) * ratio), qRound(rect.width() * ratio),
+                   qRound(rect.height() * ratio));
+        m_renderer.render(*m_tiles[i].textures);
+    }
+    glViewport(0, 0, qRound(width() * ratio), surfaceHeight);
+}
+
+void DeviceWall::resizeGL(int width, int height)
+{
+    Q_UNUSED(width)
+    Q_UNUSED(height)
+    // the viewports are set for every tile in paintGL()
+}
+
+int DeviceWall::indexOf(const QString &serial) const
+{
+    for (int i = 0; i < m_tiles.size(); i++) {
+        if (m_tiles[i].serial == serial) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void DeviceWall::uploadPendingFrames()
+{
+    // the context is current in paintGL()
+    for (auto &tile : m_tiles) {
+        tile.textures->initialize();
+        if (tile.pendingFrame.isNull()) {
+            continue;
+        }
+        const qsc::VideoFrame &frame = tile.pendingFrame;
+        const quint8 *pixels[3] = { frame.data(0), frame.data(1), frame.data(2) };
+        quint32 strides[3] = { static_cast<quint32>(frame.linesize(0)), static_cast<quint32>(frame.linesize(1)),
+                               static_cast<quint32>(frame.linesize(2)) };
+        tile.textures->setFrameSize(QSize(frame.width(), frame.height()));
+        tile.textures->update(pixels, strides);
+        // give the frame back to the decoder
+        tile.pendingFrame = qsc::VideoFrame();
+    }
+}
+
+QRect DeviceWall::tileRect(int index, const QSize &frameSize) const
+{
+    int count = m_tiles.size();
+    if (count <= 0 || frameSize.isEmpty()) {
+        return QRect();
+    }
+
+    // a grid as square as possible, each stream keeps its ratio in its cell
+    int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    int rows = (count + columns - 1) / columns;
+    int cellWidth = width() / columns;
+    int cellHeight = height() / rows;
+    QRect cell((index % columns) * cellWidth, (index / columns) * cellHeight, cellWidth, cellHeight);
+
+    QSize size = frameSize.scaled(cell.size(), Qt::KeepAspectRatio);
+    return QRect(cell.x() + (cell.width() - size.width()) / 2, cell.y() + (cell.height() - size.height()) / 2, size.width(), size.height());
+}
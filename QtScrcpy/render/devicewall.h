@@ -0,0 +1,61 @@
+#ifndef DEVICEWALL_H
+#define DEVICEWALL_H
+#include <QOpenGLFunctions>
+#include <QOpenGLWidget>
+#include <QVector>
+
+#include "../QtScrcpyCore/include/QtScrcpyCore.h"
+#include "yuvrenderer.h"
+
+class YUVTextures;
+class DeviceWallObserver;
+
+// Device wall: all the device streams are drawn in one GL context, one tile
+// per device, with a single YUV shader and one swap per repaint.
+// The frames received between two repaints only keep the newest one, they
+// are uploaded together at the beginning of the next paintGL().
+class DeviceWall
+    : public QOpenGLWidget
+    , protected QOpenGLFunctions
+{
+    Q_OBJECT
+public:
+    explicit DeviceWall(QWidget *parent = nullptr);
+    virtual ~DeviceWall() override;
+
+    // the observer to register on the device, owned by the wall
+    qsc::DeviceObserver *addDevice(const QString &serial);
+    qsc::DeviceObserver *observer(const QString &serial);
+    void removeDevice(const QString &serial);
+    int deviceCount() const;
+    // trilinear minification with mipmaps for all the tiles
+    void setMipmap(bool mipmap);
+
+    void pushFrame(const QString &serial, const qsc::VideoFrame &frame);
+
+protected:
+    void initializeGL() override;
+    void paintGL() override;
+    void resizeGL(int width, int height) override;
+
+private:
+    struct Tile
+    {
+        QString serial;
+        DeviceWallObserver *observer = Q_NULLPTR;
+        YUVTextures *textures = Q_NULLPTR;
+        qsc::VideoFrame pendingFrame;
+    };
+
+    int indexOf(const QString &serial) const;
+    void uploadPendingFrames();
+    QRect tileRect(int index, const QSize &frameSize) const;
+
+private:
+    QVector<Tile> m_tiles;
+    YUVRenderer m_renderer;
+    bool m_initialized = false;
+    bool m_mipmap = false;
+};
+
+#endif // DEVICEWALL_H
@@ -0,0 +1,177 @@
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DIRTYTILES_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DIRTYTILES_NEON
+#endif
+
+#include "dirtytiles.h"
+
+DirtyTiles::DirtyTiles() {}
+
+DirtyTiles::~DirtyTiles() {}
+
+void DirtyTiles::reset()
+{
+    m_valid = false;
+    m_skipCompares = 1;
+    m_skippedCompares = 0;
+}
+
+QVector<QRect> DirtyTiles::update(const QSize &frameSize, const quint8 *const pixels[3], const quint32 strides[3])
+{
+    QVector<QRect> rects;
+    QRect frameRect(QPoint(0, 0), frameSize);
+    if (frameSize.isEmpty() || !pixels[0] || !pixels[1] || !pixels[2]) {
+        return rects;
+    }
+
+    if (!m_valid || m_frameSize != frameSize) {
+        // same plane sizes as the textures
+        m_frameSize = frameSize;
+        m_planeSizes[0] = frameSize;
+        m_planeSizes[1] = frameSize / 2;
+        m_planeSizes[2] = frameSize / 2;
+        for (int i = 0; i < 3; i++) {
+            m_planes[i].resize(static_cast<size_t>(m_planeSizes[i].width()) * m_planeSizes[i].height());
+            copyRect(i, QRect(QPoint(0, 0), m_planeSizes[i]), pixels[i], strides[i]);
+        }
+        m_valid = true;
+        m_skippedCompares = 0;
+        rects.append(frameRect);
+        return rects;
+    }
+
+    if (m_skippedCompares > 0) {
+        // the last compared frame changed almost entirely (video playing):
+        // assume this one did too, neither compared nor copied
+        if (0 == --m_skippedCompares) {
+            // the copy is stale, take this frame for the next compare
+            for (int i = 0; i < 3; i++) {
+                copyRect(i, QRect(QPoint(0, 0), m_planeSizes[i]), pixels[i], strides[i]);
+            }
+        }
+        rects.append(frameRect);
+        return rects;
+    }
+
+    int columns = (frameSize.width() + s_tileSize - 1) / s_tileSize;
+    int rows = (frameSize.height() + s_tileSize - 1) / s_tileSize;
+    m_dirty.assign(static_cast<size_t>(columns) * rows, false);
+    int dirtyCount = 0;
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            QRect tile = QRect(column * s_tileSize, row * s_tileSize, s_tileSize, s_tileSize).intersected(frameRect);
+            bool dirty = false;
+            for (int i = 0; i < 3 && !dirty; i++) {
+                QRect rect = planeRect(i, tile, m_planeSizes[i]);
+                dirty = !rect.isEmpty() && tileChanged(i, rect, pixels[i], strides[i]);
+            }
+            if (!dirty) {
+                continue;
+            }
+            for (int i = 0; i < 3; i++) {
+                copyRect(i, planeRect(i, tile, m_planeSizes[i]), pixels[i], strides[i]);
+            }
+            m_dirty[row * columns + column] = true;
+            dirtyCount++;
+        }
+    }
+
+    if (dirtyCount * 2 > columns * rows) {
+        // one full upload is cheaper than many small ones; skip the compares
+        // of the next frames, longer each time the frame changes entirely again
+        m_skippedCompares = m_skipCompares;
+        m_skipCompares = qMin(m_skipCompares * 2, static_cast<int>(s_maxSkippedCompares));
+        rects.append(frameRect);
+        return rects;
+    }
+    m_skipCompares = 1;
+    if (0 == dirtyCount) {
+        return rects;
+    }
+
+    // merge the horizontal runs of dirty tiles
+    for (int row = 0; row < rows; row++) {
+        int column = 0;
+        while (column < columns) {
+            if (!m_dirty[row * columns + column]) {
+                column++;
+                continue;
+            }
+            int start = column;
+            while (column < columns && m_dirty[row * columns + column]) {
+                column++;
+            }
+            rects.append(QRect(start * s_tileSize, row * s_tileSize, (column - start) * s_tileSize, s_tileSize).intersected(frameRect));
+        }
+    }
+    return rects;
+}
+
+bool DirtyTiles::tileChanged(int plane, const QRect &rect, const quint8 *pixels, quint32 stride) const
+{
+    const quint8 *previous = m_planes[plane].data();
+    int previousStride = m_planeSizes[plane].width();
+    for (int y = rect.top(); y <= rect.bottom(); y++) {
+        if (!rowEqual(previous + y * previousStride + rect.left(), pixels + y * stride + rect.left(), rect.width())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DirtyTiles::copyRect(int plane, const QRect &rect, const quint8 *pixels, quint32 stride)
+{
+    quint8 *previous = m_planes[plane].data();
+    int previousStride = m_planeSizes[plane].width();
+    for (int y = rect.top(); y <= rect.bottom(); y++) {
+        memcpy(previous + y * previousStride + rect.left(), pixels + y * stride + rect.left(), rect.width());
+    }
+}
+
+QRect DirtyTiles::planeRect(int plane, const QRect &lumaRect, const QSize &planeSize)
+{
+    if (0 == plane) {
+        return lumaRect;
+    }
+    // the tiles are aligned on 2 luma pixels
+    return QRect(lumaRect.x() / 2, lumaRect.y() / 2, (lumaRect.width() + 1) / 2, (lumaRect.height() + 1) / 2).intersected(QRect(QPoint(0, 0), planeSize));
+}
+
+bool DirtyTiles::rowEqual(const quint8 *a, const quint8 *b, int size)
+{
+    int i = 0;
+#if defined(DIRTYTILES_SSE2)
+    for (; i + 64 <= size; i += 64) {
+        __m128i diff = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        diff = _mm_or_si128(
+            diff, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 16)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 16))));
+        diff = _mm_or_si128(
+            diff, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 32)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 32))));
+        diff = _mm_or_si128(
+            diff, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 48)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 48))));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF) {
+            return false;
+        }
+    }
+    for (; i + 16 <= size; i += 16) {
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        if (_mm_movemask_epi8(equal) != 0xFFFF) {
+            return false;
+        }
+    }
+#elif defined(DIRTYTILES_NEON)
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t diff = veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        uint64x2_t diff64 = vreinterpretq_u64_u8(diff);
+        if (vgetq_lane_u64(diff64, 0) | vgetq_lane_u64(diff64, 1)) {
+            return false;
+        }
+    }
+#endif
+    return 0 == memcmp(a + i, b + i, size - i);
+}
@@ -0,0 +1,48 @@
+#ifndef DIRTYTILES_H
+#define DIRTYTILES_H
+
+#include <vector>
+#include <QRect>
+#include <QSize>
+#include <QVector>
+
+// Finds the tiles of a YUV420P frame which changed since the previous one.
+// A copy of the last frame is kept (only the changed tiles are copied into
+// it), so the result doesn't depend on how the decoder reuses its buffers.
+// While the frames change entirely, the compares are skipped for a growing
+// number of frames, reported as fully changed.
+class DirtyTiles
+{
+public:
+    // luma pixels, the chroma tiles are half
+    static const int s_tileSize = 64;
+    // frames reported as fully changed without a compare, at most
+    static const int s_maxSkippedCompares = 32;
+
+    DirtyTiles();
+    virtual ~DirtyTiles();
+
+    // the next update() reports the whole frame
+    void reset();
+    // rects of the changed areas in luma coordinates, empty when nothing changed
+    QVector<QRect> update(const QSize &frameSize, const quint8 *const pixels[3], const quint32 strides[3]);
+    // rect of a plane (0: Y, 1: U, 2: V) covering a luma rect
+    static QRect planeRect(int plane, const QRect &lumaRect, const QSize &planeSize);
+
+private:
+    bool tileChanged(int plane, const QRect &rect, const quint8 *pixels, quint32 stride) const;
+    void copyRect(int plane, const QRect &rect, const quint8 *pixels, quint32 stride);
+    static bool rowEqual(const quint8 *a, const quint8 *b, int size);
+
+private:
+    QSize m_frameSize;
+    QSize m_planeSizes[3];
+    std::vector<quint8> m_planes[3];
+    bool m_valid = false;
+    std::vector<bool> m_dirty;
+    // frames left to skip, and how many the next fully changed frame skips
+    int m_skippedCompares = 0;
+    int m_skipCompares = 1;
+};
+
+#endif // DIRTYTILES_H
@@ -0,0 +1,177 @@
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAMEDOWNSCALER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FRAMEDOWNSCALER_NEON
+#endif
+
+#include "framedownscaler.h"
+
+// the texture still gets at least the window resolution
+static const int s_maxScaleFactor = 8;
+
+FrameDownscaler::FrameDownscaler(QObject *parent) : QThread(parent) {}
+
+FrameDownscaler::~FrameDownscaler()
+{
+    stopDownscaler();
+}
+
+int FrameDownscaler::scaleFactor(const QSize &frameSize, const QSize &targetSize)
+{
+    if (frameSize.isEmpty() || targetSize.isEmpty()) {
+        return 1;
+    }
+    int factor = 1;
+    while (factor < s_maxScaleFactor && frameSize.width() / (factor * 2) >= targetSize.width()
+           && frameSize.height() / (factor * 2) >= targetSize.height()) {
+        factor *= 2;
+    }
+    return factor;
+}
+
+void FrameDownscaler::push(const qsc::VideoFrame &frame, int factor)
+{
+    if (!isRunning()) {
+        m_stopped = false;
+        start();
+    }
+    QMutexLocker locker(&m_mutex);
+    // an older frame not downscaled yet is dropped
+    m_pendingFrame = frame;
+    m_pendingFactor = factor;
+    m_cond.wakeOne();
+}
+
+bool FrameDownscaler::takeFrame(QByteArray &planes, QSize &size, qint64 &decodedTimeUs)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_ready) {
+        return false;
+    }
+    planes.swap(m_planes);
+    size = m_size;
+    decodedTimeUs = m_decodedTimeUs;
+    m_ready = false;
+    return true;
+}
+
+void FrameDownscaler::stopDownscaler()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopped = true;
+        m_pendingFrame = qsc::VideoFrame();
+        m_cond.wakeOne();
+    }
+    wait();
+}
+
+void FrameDownscaler::run()
+{
+    QByteArray planes;
+    QSize size;
+    while (true) {
+        qsc::VideoFrame frame;
+        int factor = 1;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_stopped && m_pendingFrame.isNull()) {
+                m_cond.wait(&m_mutex);
+            }
+            if (m_stopped) {
+                break;
+            }
+            frame = m_pendingFrame;
+            factor = m_pendingFactor;
+            m_pendingFrame = qsc::VideoFrame();
+        }
+
+        downscale(frame, factor, planes, size);
+        qint64 decodedTimeUs = frame.decodedTimeUs();
+        // give the frame back to the decoder
+        frame = qsc::VideoFrame();
+
+        {
+            QMutexLocker locker(&m_mutex);
+            m_planes.swap(planes);
+            m_size = size;
+            m_decodedTimeUs = decodedTimeUs;
+            m_ready = true;
+        }
+        emit frameDownscaled();
+    }
+}
+
+void FrameDownscaler::halve(const quint8 *src, int srcStride, int dstWidth, int dstHeight, quint8 *dst, int dstStride)
+{
+    // 2x2 box filter
+    for (int y = 0; y < dstHeight; y++) {
+        const quint8 *row0 = src + 2 * y * srcStride;
+        const quint8 *row1 = row0 + srcStride;
+        quint8 *out = dst + y * dstStride;
+        int x = 0;
+#if defined(FRAMEDOWNSCALER_SSE2)
+        const __m128i mask = _mm_set1_epi16(0x00FF);
+        for (; x + 16 <= dstWidth; x += 16) {
+            __m128i a = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 2 * x)),
+                                     _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 2 * x)));
+            __m128i b = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 2 * x + 16)),
+                                     _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 2 * x + 16)));
+            // average of the even and odd bytes
+            __m128i lo = _mm_avg_epu16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8));
+            __m128i hi = _mm_avg_epu16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(lo, hi));
+        }
+#elif defined(FRAMEDOWNSCALER_NEON)
+        for (; x + 16 <= dstWidth; x += 16) {
+            uint8x16x2_t a = vld2q_u8(row0 + 2 * x);
+            uint8x16x2_t b = vld2q_u8(row1 + 2 * x);
+            vst1q_u8(out + x, vrhaddq_u8(vrhaddq_u8(a.val[0], a.val[1]), vrhaddq_u8(b.val[0], b.val[1])));
+        }
+#endif
+        for (; x < dstWidth; x++) {
+            out[x] = static_cast<quint8>((row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1] + 2) >> 2);
+        }
+    }
+}
+
+void FrameDownscaler::downscale(const qsc::VideoFrame &frame, int factor, QByteArray &planes, QSize &size)
+{
+    // even size, the chroma planes are exactly half
+    size = QSize((frame.width() / factor) & ~1, (frame.height() / factor) & ~1);
+    QSize sizes[3] = { size, size / 2, size / 2 };
+    planes.resize(sizes[0].width() * sizes[0].height() + 2 * sizes[1].width() * sizes[1].height());
+
+    quint8 *dst = reinterpret_cast<quint8 *>(planes.data());
+    for (int i = 0; i < 3; i++) {
+        const quint8 *src = frame.data(i);
+        int srcStride = frame.linesize(i);
+        int width = sizes[i].width() * factor;
+        // halve until the last pass, which writes into the packed planes
+        for (int f = factor; f > 2; f /= 2) {
+            int halfWidth = width / 2;
+            int halfHeight = sizes[i].height() * f / 2;
+            if (m_buffer.size() < halfWidth * halfHeight) {
+                m_buffer.resize(halfWidth * halfHeight);
+            }
+            quint8 *buffer = reinterpret_cast<quint8 *>(m_buffer.data());
+            halve(src, srcStride, halfWidth, halfHeight, buffer, halfWidth);
+            // in place for the next pass, rows are read before being overwritten
+            src = buffer;
+            srcStride = halfWidth;
+            width = halfWidth;
+        }
+        if (factor > 1) {
+            halve(src, srcStride, sizes[i].width(), sizes[i].height(), dst, sizes[i].width());
+        } else {
+            for (int y = 0; y < sizes[i].height(); y++) {
+                memcpy(dst + y * sizes[i].width(), src + y * srcStride, sizes[i].width());
+            }
+        }
+        dst += sizes[i].width() * sizes[i].height();
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef FRAMEDOWNSCALER_H
+#define FRAMEDOWNSCALER_H
+#include <QByteArray>
+#include <QMutex>
+#include <QSize>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "../QtScrcpyCore/include/videoframe.h"
+
+// Downscales YUV420P frames by a power of 2 on its own thread, so a small
+// window doesn't upload (and sample) the full resolution of the stream.
+// Only the newest frame is kept while a downscale is in progress.
+class FrameDownscaler : public QThread
+{
+    Q_OBJECT
+public:
+    explicit FrameDownscaler(QObject *parent = Q_NULLPTR);
+    virtual ~FrameDownscaler();
+
+    // power of 2 such that the downscaled frame still covers the target size
+    static int scaleFactor(const QSize &frameSize, const QSize &targetSize);
+
+    void push(const qsc::VideoFrame &frame, int factor);
+    // Y, U and V planes packed without padding, the U/V planes are size / 2,
+    // decodedTimeUs is the one of the source frame
+    bool takeFrame(QByteArray &planes, QSize &size, qint64 &decodedTimeUs);
+    void stopDownscaler();
+
+signals:
+    void frameDownscaled();
+
+protected:
+    void run() override;
+
+private:
+    static void halve(const quint8 *src, int srcStride, int dstWidth, int dstHeight, quint8 *dst, int dstStride);
+    void downscale(const qsc::VideoFrame &frame, int factor, QByteArray &planes, QSize &size);
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    bool m_stopped = false;
+    qsc::VideoFrame m_pendingFrame;
+    int m_pendingFactor = 1;
+    QByteArray m_planes;
+    QSize m_size;
+    qint64 m_decodedTimeUs = 0;
+    bool m_ready = false;
+    // intermediate plane for the factors above 2
+    QByteArray m_buffer;
+};
+
+#endif // FRAMEDOWNSCALER_H
@@ -0,0 +1,33 @@
+#ifndef IYUVWIDGET_H
+#define IYUVWIDGET_H
+
+#include <QByteArray>
+#include <QSize>
+
+#include "../QtScrcpyCore/include/videoframe.h"
+#include "presentstats.h"
+
+// What the video window needs from a YUV420P render widget, implemented by
+// the OpenGL widget and by the software (QPainter) one.
+class IYUVWidget
+{
+public:
+    virtual ~IYUVWidget() {}
+
+    virtual void setFrameSize(const QSize &frameSize) = 0;
+    virtual const QSize &frameSize() = 0;
+    // show the frame with the next refresh, a frame still waiting for it is
+    // replaced (and counted as not presented)
+    virtual void presentFrame(const qsc::VideoFrame &frame) = 0;
+    // same with a downscaled YUV420P frame, tightly packed, frameSize() stays
+    // the size of the stream
+    virtual void presentScaledFrame(const QSize &size, const QByteArray &planes, qint64 decodedTimeUs) = 0;
+    virtual const PresentStats &presentStats() const = 0;
+    // bytes not uploaded thanks to the unchanged tiles, over the last second
+    virtual quint64 uploadBytesSavedPerSecond() const = 0;
+    // higher quality minification, may be changed at any time
+    virtual void setMipmap(bool mipmap) = 0;
+    virtual bool mipmap() const = 0;
+};
+
+#endif // IYUVWIDGET_H
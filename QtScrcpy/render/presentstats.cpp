@@ -0,0 +1,42 @@
+#include "../QtScrcpyCore/include/videoframe.h"
+#include "presentstats.h"
+
+PresentStatsCounter::PresentStatsCounter() {}
+
+PresentStatsCounter::~PresentStatsCounter() {}
+
+void PresentStatsCounter::framePresented(qint64 decodedTimeUs)
+{
+    m_stats.framesPresented++;
+    if (decodedTimeUs <= 0) {
+        return;
+    }
+
+    qint64 latency = qsc::VideoFrame::currentTimeUs() - decodedTimeUs;
+    m_stats.lastLatencyUs = latency;
+    m_windowLatencySumUs += latency;
+    m_windowLatencyMaxUs = qMax(m_windowLatencyMaxUs, latency);
+    m_windowFrames++;
+
+    if (!m_windowTimer.isValid()) {
+        m_windowTimer.start();
+    }
+    if (m_windowTimer.elapsed() >= 1000) {
+        m_stats.averageLatencyUs = m_windowLatencySumUs / m_windowFrames;
+        m_stats.maxLatencyUs = m_windowLatencyMaxUs;
+        m_windowLatencySumUs = 0;
+        m_windowLatencyMaxUs = 0;
+        m_windowFrames = 0;
+        m_windowTimer.restart();
+    }
+}
+
+void PresentStatsCounter::frameNotPresented()
+{
+    m_stats.framesNotPresented++;
+}
+
+const PresentStats &PresentStatsCounter::stats() const
+{
+    return m_stats;
+}
@@ -0,0 +1,39 @@
+#ifndef PRESENTSTATS_H
+#define PRESENTSTATS_H
+
+#include <QElapsedTimer>
+
+struct PresentStats
+{
+    quint64 framesPresented = 0;
+    // decoded, then replaced by a newer frame before being shown, or never
+    // drawn (same picture as the one on screen, no GL context yet)
+    quint64 framesNotPresented = 0;
+    // decode to present latency of the last frame, and over the last second
+    qint64 lastLatencyUs = 0;
+    qint64 averageLatencyUs = 0;
+    qint64 maxLatencyUs = 0;
+};
+
+// Counts what the render widgets show, see PresentStats.
+class PresentStatsCounter
+{
+public:
+    PresentStatsCounter();
+    virtual ~PresentStatsCounter();
+
+    // decodedTimeUs: qsc::VideoFrame::decodedTimeUs(), 0 if unknown
+    void framePresented(qint64 decodedTimeUs);
+    void frameNotPresented();
+    const PresentStats &stats() const;
+
+private:
+    PresentStats m_stats;
+    // latencies of the current second
+    QElapsedTimer m_windowTimer;
+    qint64 m_windowLatencySumUs = 0;
+    qint64 m_windowLatencyMaxUs = 0;
+    int m_windowFrames = 0;
+};
+
+#endif // PRESENTSTATS_H
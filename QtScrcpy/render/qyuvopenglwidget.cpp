@@ -1,91 +1,14 @@
-#include <QCoreApplication>
-#include <QOpenGLTexture>
 #include <QSurfaceFormat>
 
 #include "qyuvopenglwidget.h"
 
-// 存储顶点坐标和纹理坐标
-// 存在一起缓存在vbo
-// 使用glVertexAttribPointer指定访问方式即可
-static const GLfloat coordinate[] = {
-    // 顶点坐标，存储4个xyz坐标
-    // 坐标范围为[-1,1],中心点为 0,0
-    // 二维图像z始终为0
-    // GL_TRIANGLE_STRIP的绘制方式：
-    // 使用前3个坐标绘制一个三角形，使用后三个坐标绘制一个三角形，正好为一个矩形
-    // x     y     z
-    -1.0f,
-    -1.0f,
-    0.0f,
-    1.0f,
-    -1.0f,
-    0.0f,
-    -1.0f,
-    1.0f,
-    0.0f,
-    1.0f,
-    1.0f,
-    0.0f,
-
-    // 纹理坐标，存储4个xy坐标
-    // 坐标范围为[0,1],左下角为 0,0
-    0.0f,
-    1.0f,
-    1.0f,
-    1.0f,
-    0.0f,
-    0.0f,
-    1.0f,
-    0.0f
-};
-
-// 顶点着色器
-static const QString s_vertShader = R"(
-    attribute vec3 vertexIn;    // xyz顶点坐标
-    attribute vec2 textureIn;   // xy纹理坐标
-    varying vec2 textureOut;    // 传递给片段着色器的纹理坐标
-    void main(void)
-    {
-        gl_Position = vec4(vertexIn, 1.0);  // 1.0表示vertexIn是一个顶点位置
-        textureOut = textureIn; // 纹理坐标直接传递给片段着色器
-    }
-)";
-
-// 片段着色器
-static QString s_fragShader = R"(
-    varying vec2 textureOut;        // 由顶点着色器传递过来的纹理坐标
-    uniform sampler2D textureY;     // uniform 纹理单元，利用纹理单元可以使用多个纹理
-    uniform sampler2D textureU;     // sampler2D是2D采样器
-    uniform sampler2D textureV;     // 声明yuv三个纹理单元
-    void main(void)
-    {
-        vec3 yuv;
-        vec3 rgb;
-
-        // SDL2 BT709_SHADER_CONSTANTS
-        // https://github.com/spurious/SDL-mirror/blob/4ddd4c445aa059bb127e101b74a8c5b59257fbe2/src/render/opengl/SDL_shaders_gl.c#L102
-        const vec3 Rcoeff = vec3(1.1644,  0.000,  1.7927);
-        const vec3 Gcoeff = vec3(1.1644, -0.2132, -0.5329);
-        const vec3 Bcoeff = vec3(1.1644,  2.1124,  0.000);
-
-        // 根据指定的纹理textureY和坐标textureOut来采样
-        yuv.x = texture2D(textureY, textureOut).r;
-        yuv.y = texture2D(textureU, textureOut).r - 0.5;
-        yuv.z = texture2D(textureV, textureOut).r - 0.5;
-
-        // 采样完转为rgb
-        // 减少一些亮度
-        yuv.x = yuv.x - 0.0625;
-        rgb.r = dot(yuv, Rcoeff);
-        rgb.g = dot(yuv, Gcoeff);
-        rgb.b = dot(yuv, Bcoeff);
-        // 输出颜色值
-        gl_FragColor = vec4(rgb, 1.0);
-    }
-)";
+// a hidden or minimized window doesn't swap, the frames are uploaded anyway after this
+static const int s_swapTimeoutMs = 100;
 
 QYUVOpenGLWidget::QYUVOpenGLWidget(QWidget *parent) : QOpenGLWidget(parent)
 {
+    connect(this, &QOpenGLWidget::frameSwapped, this, &QYUVOpenGLWidget::onFrameSwapped);
+
     /*
     QSurfaceFormat format = QSurfaceFormat::defaultFormat();
     format.setColorSpace(QSurfaceFormat::sRGBColorSpace);
@@ -99,8 +22,8 @@ QYUVOpenGLWidget::QYUVOpenGLWidget(QWidget *parent) : QOpenGLWidget(parent)
 QYUVOpenGLWidget::~QYUVOpenGLWidget()
 {
     makeCurrent();
-    m_vbo.destroy();
-    deInitTextures();
+    m_renderer.deInitialize();
+    m_textures.deInitialize();
     doneCurrent();
 }
 
@@ -116,12 +39,9 @@ QSize QYUVOpenGLWidget::sizeHint() const
 
 void QYUVOpenGLWidget::setFrameSize(const QSize &frameSize)
 {
-    if (m_frameSize != frameSize) {
-        m_frameSize = frameSize;
-        m_needUpdate = true;
-        // inittexture immediately
-        repaint();
-    }
+    // the textures follow with the next upload, taken from their pool,
+    // no synchronous repaint
+    m_frameSize = frameSize;
 }
 
 const QSize &QYUVOpenGLWidget::frameSize()
@@ -129,149 +49,144 @@ const QSize &QYUVOpenGLWidget::frameSize()
     return m_frameSize;
 }
 
-void QYUVOpenGLWidget::updateTextures(quint8 *dataY, quint8 *dataU, quint8 *dataV, quint32 linesizeY, quint32 linesizeU, quint32 linesizeV)
+void QYUVOpenGLWidget::presentFrame(const qsc::VideoFrame &frame)
 {
-    if (m_textureInited) {
-        updateTexture(m_texture[0], 0, dataY, linesizeY);
-        updateTexture(m_texture[1], 1, dataU, linesizeU);
-        updateTexture(m_texture[2], 2, dataV, linesizeV);
-        update();
-    }
+    PendingFrame pending;
+    pending.frame = frame;
+    pending.size = QSize(frame.width(), frame.height());
+    pending.decodedTimeUs = frame.decodedTimeUs();
+    offerFrame(pending);
 }
 
-void QYUVOpenGLWidget::initializeGL()
+void QYUVOpenGLWidget::presentScaledFrame(const QSize &size, const QByteArray &planes, qint64 decodedTimeUs)
 {
-    initializeOpenGLFunctions();
-    glDisable(GL_DEPTH_TEST);
-
-    // 顶点缓冲对象初始化
-    m_vbo.create();
-    m_vbo.bind();
-    m_vbo.allocate(coordinate, sizeof(coordinate));
-    initShader();
-    // 设置背景清理色为黑色
-    glClearColor(0.0, 0.0, 0.0, 0.0);
-    // 清理颜色背景
-    glClear(GL_COLOR_BUFFER_BIT);
+    PendingFrame pending;
+    pending.size = size;
+    pending.planes = planes;
+    pending.decodedTimeUs = decodedTimeUs;
+    offerFrame(pending);
 }
 
-void QYUVOpenGLWidget::paintGL()
+const PresentStats &QYUVOpenGLWidget::presentStats() const
 {
-    m_shaderProgram.bind();
+    return m_presentStats.stats();
+}
 
-    if (m_needUpdate) {
-        deInitTextures();
-        initTextures();
-        m_needUpdate = false;
+void QYUVOpenGLWidget::offerFrame(const PendingFrame &frame)
+{
+    if (m_pendingFrame.valid) {
+        // replaced before the swap, never shown
+        m_presentStats.frameNotPresented();
     }
+    m_pendingFrame = frame;
+    m_pendingFrame.valid = true;
 
-    if (m_textureInited) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_texture[0]);
+    if (m_swapPending && m_swapTimer.elapsed() > s_swapTimeoutMs) {
+        m_swapPending = false;
+        m_presentStats.frameNotPresented();
+    }
+    if (!m_swapPending) {
+        uploadPendingFrame();
+    }
+}
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, m_texture[1]);
+void QYUVOpenGLWidget::uploadPendingFrame()
+{
+    PendingFrame frame = m_pendingFrame;
+    m_pendingFrame = PendingFrame();
+
+    const quint8 *pixels[3];
+    quint32 strides[3];
+    if (!frame.frame.isNull()) {
+        for (int i = 0; i < 3; i++) {
+            pixels[i] = frame.frame.data(i);
+            strides[i] = static_cast<quint32>(frame.frame.linesize(i));
+        }
+    } else {
+        pixels[0] = reinterpret_cast<const quint8 *>(frame.planes.constData());
+        pixels[1] = pixels[0] + frame.size.width() * frame.size.height();
+        pixels[2] = pixels[1] + (frame.size.width() / 2) * (frame.size.height() / 2);
+        strides[0] = static_cast<quint32>(frame.size.width());
+        strides[1] = static_cast<quint32>(frame.size.width() / 2);
+        strides[2] = static_cast<quint32>(frame.size.width() / 2);
+    }
 
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, m_texture[2]);
+    if (!uploadTextures(frame.size, pixels, strides)) {
+        // same picture as the one on screen, or no GL context yet: nothing
+        // is drawn for this frame
+        m_presentStats.frameNotPresented();
+        return;
+    }
+    m_swapPending = true;
+    m_swapDecodedTimeUs = frame.decodedTimeUs;
+    m_swapTimer.start();
+    update();
+}
 
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+void QYUVOpenGLWidget::onFrameSwapped()
+{
+    // swaps of resizes and other repaints
+    if (!m_swapPending) {
+        return;
     }
+    m_swapPending = false;
+    m_presentStats.framePresented(m_swapDecodedTimeUs);
+    // the newest frame received meanwhile, uploaded right after the swap
+    if (m_pendingFrame.valid) {
+        uploadPendingFrame();
+    }
+}
 
-    m_shaderProgram.release();
+bool QYUVOpenGLWidget::uploadTextures(const QSize &size, const quint8 *const pixels[3], const quint32 strides[3])
+{
+    // make the context current once for the three planes
+    makeCurrent();
+    // the textures are recreated when switching between full and downscaled size
+    m_textures.setFrameSize(size);
+    bool changed = m_textures.update(pixels, strides);
+    doneCurrent();
+    return changed;
 }
 
-void QYUVOpenGLWidget::resizeGL(int width, int height)
+quint64 QYUVOpenGLWidget::uploadBytesSavedPerSecond() const
 {
-    glViewport(0, 0, width, height);
-    repaint();
+    return m_textures.uploadBytesSavedPerSecond();
 }
 
-void QYUVOpenGLWidget::initShader()
+void QYUVOpenGLWidget::setMipmap(bool mipmap)
 {
-    // opengles的float、int等要手动指定精度
-    if (QCoreApplication::testAttribute(Qt::AA_UseOpenGLES)) {
-        s_fragShader.prepend(R"(
-                             precision mediump int;
-                             precision mediump float;
-                             )");
+    if (m_textures.mipmap() == mipmap) {
+        return;
     }
-    m_shaderProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, s_vertShader);
-    m_shaderProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, s_fragShader);
-    m_shaderProgram.link();
-    m_shaderProgram.bind();
-
-    // 指定顶点坐标在vbo中的访问方式
-    // 参数解释：顶点坐标在shader中的参数名称，顶点坐标为float，起始偏移为0，顶点坐标类型为vec3，步幅为3个float
-    m_shaderProgram.setAttributeBuffer("vertexIn", GL_FLOAT, 0, 3, 3 * sizeof(float));
-    // 启用顶点属性
-    m_shaderProgram.enableAttributeArray("vertexIn");
-
-    // 指定纹理坐标在vbo中的访问方式
-    // 参数解释：纹理坐标在shader中的参数名称，纹理坐标为float，起始偏移为12个float（跳过前面存储的12个顶点坐标），纹理坐标类型为vec2，步幅为2个float
-    m_shaderProgram.setAttributeBuffer("textureIn", GL_FLOAT, 12 * sizeof(float), 2, 2 * sizeof(float));
-    m_shaderProgram.enableAttributeArray("textureIn");
-
-    // 关联片段着色器中的纹理单元和opengl中的纹理单元（opengl一般提供16个纹理单元）
-    m_shaderProgram.setUniformValue("textureY", 0);
-    m_shaderProgram.setUniformValue("textureU", 1);
-    m_shaderProgram.setUniformValue("textureV", 2);
+    m_textures.setMipmap(mipmap);
+    update();
 }
 
-void QYUVOpenGLWidget::initTextures()
+bool QYUVOpenGLWidget::mipmap() const
 {
-    // 创建纹理
-    glGenTextures(1, &m_texture[0]);
-    glBindTexture(GL_TEXTURE_2D, m_texture[0]);
-    // 设置纹理缩放时的策略
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // 设置st方向上纹理超出坐标时的显示策略
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, m_frameSize.width(), m_frameSize.height(), 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
-
-    glGenTextures(1, &m_texture[1]);
-    glBindTexture(GL_TEXTURE_2D, m_texture[1]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, m_frameSize.width() / 2, m_frameSize.height() / 2, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
-
-    glGenTextures(1, &m_texture[2]);
-    glBindTexture(GL_TEXTURE_2D, m_texture[2]);
-    // 设置纹理缩放时的策略
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // 设置st方向上纹理超出坐标时的显示策略
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, m_frameSize.width() / 2, m_frameSize.height() / 2, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
-
-    m_textureInited = true;
+    return m_textures.mipmap();
 }
 
-void QYUVOpenGLWidget::deInitTextures()
+void QYUVOpenGLWidget::initializeGL()
 {
-    if (QOpenGLFunctions::isInitialized(QOpenGLFunctions::d_ptr)) {
-        glDeleteTextures(3, m_texture);
-    }
+    initializeOpenGLFunctions();
+    glDisable(GL_DEPTH_TEST);
 
-    memset(m_texture, 0, sizeof(m_texture));
-    m_textureInited = false;
+    m_renderer.initialize();
+    m_textures.initialize();
+    // 设置背景清理色为黑色
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    // 清理颜色背景
+    glClear(GL_COLOR_BUFFER_BIT);
 }
 
-void QYUVOpenGLWidget::updateTexture(GLuint texture, quint32 textureType, quint8 *pixels, quint32 stride)
+void QYUVOpenGLWidget::paintGL()
 {
-    if (!pixels)
-        return;
-
-    QSize size = 0 == textureType ? m_frameSize : m_frameSize / 2;
+    m_renderer.render(m_textures);
+}
 
-    makeCurrent();
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(stride));
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width(), size.height(), GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels);
-    doneCurrent();
+void QYUVOpenGLWidget::resizeGL(int width, int height)
+{
+    // paintGL() follows
+    glViewport(0, 0, width, height);
 }
@@ -1,12 +1,16 @@
 #ifndef QYUVOPENGLWIDGET_H
 #define QYUVOPENGLWIDGET_H
-#include <QOpenGLBuffer>
+#include <QElapsedTimer>
 #include <QOpenGLFunctions>
-#include <QOpenGLShaderProgram>
 #include <QOpenGLWidget>
 
+#include "iyuvwidget.h"
+#include "yuvrenderer.h"
+#include "yuvtextures.h"
+
 class QYUVOpenGLWidget
     : public QOpenGLWidget
+    , public IYUVWidget
     , protected QOpenGLFunctions
 {
     Q_OBJECT
@@ -17,35 +21,57 @@ public:
     QSize minimumSizeHint() const override;
     QSize sizeHint() const override;
 
-    void setFrameSize(const QSize &frameSize);
-    const QSize &frameSize();
-    void updateTextures(quint8 *dataY, quint8 *dataU, quint8 *dataV, quint32 linesizeY, quint32 linesizeU, quint32 linesizeV);
+    void setFrameSize(const QSize &frameSize) override;
+    const QSize &frameSize() override;
+    // paced with frameSwapped(): uploaded right away when the last upload is
+    // on screen, otherwise kept as the next frame until the swap
+    void presentFrame(const qsc::VideoFrame &frame) override;
+    void presentScaledFrame(const QSize &size, const QByteArray &planes, qint64 decodedTimeUs) override;
+    const PresentStats &presentStats() const override;
+    // bytes not uploaded thanks to the unchanged tiles, over the last second
+    quint64 uploadBytesSavedPerSecond() const override;
+    // trilinear minification with mipmaps, may be changed at any time
+    void setMipmap(bool mipmap) override;
+    bool mipmap() const override;
 
 protected:
     void initializeGL() override;
     void paintGL() override;
     void resizeGL(int width, int height) override;
 
+private slots:
+    void onFrameSwapped();
+
 private:
-    void initShader();
-    void initTextures();
-    void deInitTextures();
-    void updateTexture(GLuint texture, quint32 textureType, quint8 *pixels, quint32 stride);
+    struct PendingFrame
+    {
+        // either a decoded frame, or downscaled planes
+        qsc::VideoFrame frame;
+        QSize size;
+        QByteArray planes;
+        qint64 decodedTimeUs = 0;
+        bool valid = false;
+    };
+
+    void offerFrame(const PendingFrame &frame);
+    void uploadPendingFrame();
+    bool uploadTextures(const QSize &size, const quint8 *const pixels[3], const quint32 strides[3]);
 
 private:
     // 视频帧尺寸
     QSize m_frameSize = { -1, -1 };
-    bool m_needUpdate = false;
-    bool m_textureInited = false;
-
-    // 顶点缓冲对象(Vertex Buffer Objects, VBO)：默认即为VertexBuffer(GL_ARRAY_BUFFER)类型
-    QOpenGLBuffer m_vbo;
 
-    // 着色器程序：编译链接着色器
-    QOpenGLShaderProgram m_shaderProgram;
+    // YUV着色器（与设备墙共用）
+    YUVRenderer m_renderer;
+    // YUV纹理及其上传
+    YUVTextures m_textures;
 
-    // YUV纹理，用于生成纹理贴图
-    GLuint m_texture[3] = { 0 };
+    // 上传与显示同步：等待上一次上传的帧显示（frameSwapped）期间，只保留最新的一帧
+    PendingFrame m_pendingFrame;
+    bool m_swapPending = false;
+    qint64 m_swapDecodedTimeUs = 0;
+    QElapsedTimer m_swapTimer;
+    PresentStatsCounter m_presentStats;
 };
 
 #endif // QYUVOPENGLWIDGET_H
@@ -0,0 +1,122 @@
+#include <QPainter>
+
+#include "qyuvsoftwarewidget.h"
+
+QYUVSoftwareWidget::QYUVSoftwareWidget(QWidget *parent) : QWidget(parent)
+{
+    // every pixel is painted, no need to clear the background first
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+QYUVSoftwareWidget::~QYUVSoftwareWidget() {}
+
+QSize QYUVSoftwareWidget::minimumSizeHint() const
+{
+    return QSize(50, 50);
+}
+
+QSize QYUVSoftwareWidget::sizeHint() const
+{
+    return size();
+}
+
+void QYUVSoftwareWidget::setFrameSize(const QSize &frameSize)
+{
+    m_frameSize = frameSize;
+}
+
+const QSize &QYUVSoftwareWidget::frameSize()
+{
+    return m_frameSize;
+}
+
+void QYUVSoftwareWidget::presentFrame(const qsc::VideoFrame &frame)
+{
+    if (frame.isNull() || frame.width() < 2 || frame.height() < 2) {
+        return;
+    }
+    if (m_dirty) {
+        m_presentStats.frameNotPresented();
+    }
+    // only a reference, the planes are read by the next paint
+    m_frame = frame;
+    m_planes.clear();
+    m_decodedTimeUs = frame.decodedTimeUs();
+    m_dirty = true;
+    update();
+}
+
+void QYUVSoftwareWidget::presentScaledFrame(const QSize &size, const QByteArray &planes, qint64 decodedTimeUs)
+{
+    if (size.width() < 2 || size.height() < 2) {
+        return;
+    }
+    if (m_dirty) {
+        m_presentStats.frameNotPresented();
+    }
+    // already tightly packed, shared without a copy
+    m_frame = qsc::VideoFrame();
+    m_planes = planes;
+    m_planesSize = size;
+    m_decodedTimeUs = decodedTimeUs;
+    m_dirty = true;
+    update();
+}
+
+const PresentStats &QYUVSoftwareWidget::presentStats() const
+{
+    return m_presentStats.stats();
+}
+
+quint64 QYUVSoftwareWidget::uploadBytesSavedPerSecond() const
+{
+    return 0;
+}
+
+void QYUVSoftwareWidget::setMipmap(bool mipmap)
+{
+    m_mipmap = mipmap;
+}
+
+bool QYUVSoftwareWidget::mipmap() const
+{
+    return m_mipmap;
+}
+
+void QYUVSoftwareWidget::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    qreal ratio = devicePixelRatioF();
+    QSize imageSize = size() * ratio;
+    if ((m_frame.isNull() && m_planes.isEmpty()) || imageSize.isEmpty()) {
+        painter.fillRect(rect(), Qt::black);
+        return;
+    }
+
+    bool convert = m_dirty;
+    if (m_image.size() != imageSize) {
+        m_image = QImage(imageSize, QImage::Format_RGB32);
+        m_image.setDevicePixelRatio(ratio);
+        convert = true;
+    }
+    if (convert && !m_frame.isNull()) {
+        const quint8 *pixels[3] = { m_frame.data(0), m_frame.data(1), m_frame.data(2) };
+        const quint32 strides[3]
+            = { static_cast<quint32>(m_frame.linesize(0)), static_cast<quint32>(m_frame.linesize(1)), static_cast<quint32>(m_frame.linesize(2)) };
+        m_converter.convert(QSize(m_frame.width(), m_frame.height()), pixels, strides, m_image);
+    } else if (convert) {
+        const quint8 *pixels[3];
+        pixels[0] = reinterpret_cast<const quint8 *>(m_planes.constData());
+        pixels[1] = pixels[0] + m_planesSize.width() * m_planesSize.height();
+        pixels[2] = pixels[1] + (m_planesSize.width() / 2) * (m_planesSize.height() / 2);
+        const quint32 strides[3]
+            = { static_cast<quint32>(m_planesSize.width()), static_cast<quint32>(m_planesSize.width() / 2), static_cast<quint32>(m_planesSize.width() / 2) };
+        m_converter.convert(m_planesSize, pixels, strides, m_image);
+    }
+    painter.drawImage(QPoint(0, 0), m_image);
+    if (m_dirty) {
+        m_dirty = false;
+        m_presentStats.framePresented(m_decodedTimeUs);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef QYUVSOFTWAREWIDGET_H
+#define QYUVSOFTWAREWIDGET_H
+#include <QImage>
+#include <QWidget>
+
+#include "iyuvwidget.h"
+#include "yuvconverter.h"
+
+// Renders the YUV frames with QPainter, for hosts without a usable OpenGL.
+// A reference on the last frame is kept when it arrives and converted to a
+// window sized image when painting, so only the last frame before a paint is
+// converted and resizing doesn't need a new frame.
+class QYUVSoftwareWidget
+    : public QWidget
+    , public IYUVWidget
+{
+    Q_OBJECT
+public:
+    explicit QYUVSoftwareWidget(QWidget *parent = nullptr);
+    virtual ~QYUVSoftwareWidget() override;
+
+    QSize minimumSizeHint() const override;
+    QSize sizeHint() const override;
+
+    void setFrameSize(const QSize &frameSize) override;
+    const QSize &frameSize() override;
+    // converted by the next paint, the frames between two paints are not presented
+    void presentFrame(const qsc::VideoFrame &frame) override;
+    void presentScaledFrame(const QSize &size, const QByteArray &planes, qint64 decodedTimeUs) override;
+    const PresentStats &presentStats() const override;
+    // nothing is uploaded
+    quint64 uploadBytesSavedPerSecond() const override;
+    // the scaling is always bilinear, the value is only kept
+    void setMipmap(bool mipmap) override;
+    bool mipmap() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    // 视频帧尺寸
+    QSize m_frameSize = { -1, -1 };
+    // 待绘制的视频帧（只是引用，不拷贝）
+    qsc::VideoFrame m_frame;
+    // 缩小显示时缓存的YUV数据尺寸（小于视频帧尺寸），紧密排列
+    QSize m_planesSize;
+    QByteArray m_planes;
+    // 缓存的YUV数据还没有转换
+    bool m_dirty = false;
+    qint64 m_decodedTimeUs = 0;
+    PresentStatsCounter m_presentStats;
+    bool m_mipmap = false;
+
+    QImage m_image;
+    YUVConverter m_converter;
+};
+
+#endif // QYUVSOFTWAREWIDGET_H
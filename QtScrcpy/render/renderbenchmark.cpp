@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cstdio>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+
+#include "renderbenchmark.h"
+
+RenderBenchmark::RenderBenchmark() {}
+
+RenderBenchmark::~RenderBenchmark()
+{
+    deInitialize();
+}
+
+bool RenderBenchmark::initialize(const QSize &frameSize, const QSize &targetSize)
+{
+    deInitialize();
+    if (frameSize.width() < 2 || frameSize.height() < 2 || targetSize.isEmpty()) {
+        qWarning() << "render benchmark: invalid size" << frameSize << targetSize;
+        return false;
+    }
+
+    m_surface = new QOffscreenSurface();
+    m_surface->setFormat(QSurfaceFormat::defaultFormat());
+    m_surface->create();
+    m_context = new QOpenGLContext();
+    m_context->setFormat(QSurfaceFormat::defaultFormat());
+    if (!m_surface->isValid() || !m_context->create() || !m_context->makeCurrent(m_surface)) {
+        qWarning() << "render benchmark: no usable OpenGL";
+        deInitialize();
+        return false;
+    }
+    initializeOpenGLFunctions();
+    m_glRenderer = QString::fromLatin1(reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    m_glVersion = QString::fromLatin1(reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+
+    m_fbo = new QOpenGLFramebufferObject(targetSize);
+    if (!m_fbo->isValid()) {
+        qWarning() << "render benchmark: framebuffer object not supported";
+        deInitialize();
+        return false;
+    }
+
+    m_renderer.initialize();
+    m_textures.initialize();
+    m_textures.setFrameSize(frameSize);
+    m_context->doneCurrent();
+
+    m_frameSize = frameSize;
+    m_targetSize = targetSize;
+    m_planes.resize(frameSize.width() * frameSize.height() + 2 * (frameSize.width() / 2) * (frameSize.height() / 2));
+    m_readBackPixels.resize(targetSize.width() * targetSize.height() * 4);
+    return true;
+}
+
+void RenderBenchmark::deInitialize()
+{
+    if (m_context && m_surface && m_context->makeCurrent(m_surface)) {
+        m_renderer.deInitialize();
+        m_textures.deInitialize();
+        delete m_fbo;
+        m_fbo = Q_NULLPTR;
+        m_context->doneCurrent();
+    }
+    // without a current context the GL objects went with it
+    delete m_fbo;
+    m_fbo = Q_NULLPTR;
+    delete m_context;
+    m_context = Q_NULLPTR;
+    if (m_surface) {
+        m_surface->destroy();
+        delete m_surface;
+        m_surface = Q_NULLPTR;
+    }
+}
+
+bool RenderBenchmark::run(int frames, int changedPercent, bool readBack)
+{
+    if (!m_context || !m_context->makeCurrent(m_surface)) {
+        return false;
+    }
+    m_changedPercent = qBound(0, changedPercent, 100);
+    m_readBack = readBack;
+    m_uploadNsecs.clear();
+    m_drawNsecs.clear();
+    m_readBackNsecs.clear();
+    m_uploadNsecs.reserve(frames);
+    m_drawNsecs.reserve(frames);
+    m_readBackNsecs.reserve(frames);
+
+    // allocates the textures and the pbos, not measured
+    fillFrame(0, 100);
+    renderFrame(readBack, false);
+    for (int i = 1; i <= frames; i++) {
+        fillFrame(i, m_changedPercent);
+        renderFrame(readBack, true);
+    }
+    m_context->doneCurrent();
+    return true;
+}
+
+QJsonObject RenderBenchmark::report() const
+{
+    QVector<qint64> totalNsecs;
+    for (int i = 0; i < m_uploadNsecs.size(); i++) {
+        totalNsecs.append(m_uploadNsecs[i] + m_drawNsecs[i] + (m_readBack ? m_readBackNsecs[i] : 0));
+    }
+
+    QJsonObject report;
+    report["glRenderer"] = m_glRenderer;
+    report["glVersion"] = m_glVersion;
+    report["frameSize"] = QString("%1x%2").arg(m_frameSize.width()).arg(m_frameSize.height());
+    report["targetSize"] = QString("%1x%2").arg(m_targetSize.width()).arg(m_targetSize.height());
+    report["frames"] = static_cast<int>(m_uploadNsecs.size());
+    report["changedPercent"] = m_changedPercent;
+    report["upload"] = summarize(m_uploadNsecs);
+    report["draw"] = summarize(m_drawNsecs);
+    if (m_readBack) {
+        report["readBack"] = summarize(m_readBackNsecs);
+    }
+    report["total"] = summarize(totalNsecs);
+    return report;
+}
+
+int RenderBenchmark::exec(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    QCommandLineOption benchmarkOption("render-benchmark", "Run the offscreen render benchmark and exit.");
+    QCommandLineOption sizeOption("size", "Size of the video frames.", "WxH", "1920x1080");
+    QCommandLineOption targetOption("target", "Size of the rendered image, the frame size by default.", "WxH");
+    QCommandLineOption framesOption("frames", "Number of measured frames.", "N", "300");
+    QCommandLineOption changedOption("changed", "Percentage of the rows changing every frame.", "PERCENT", "100");
+    QCommandLineOption readBackOption("readback", "Read the rendered image back to memory.");
+    parser.addOption(benchmarkOption);
+    parser.addOption(sizeOption);
+    parser.addOption(targetOption);
+    parser.addOption(framesOption);
+    parser.addOption(changedOption);
+    parser.addOption(readBackOption);
+    if (!parser.parse(arguments)) {
+        qWarning() << "render benchmark:" << parser.errorText();
+        return 2;
+    }
+
+    auto parseSize = [](const QString &text) {
+        QStringList parts = text.split('x');
+        return parts.size() == 2 ? QSize(parts[0].toInt(), parts[1].toInt()) : QSize();
+    };
+    QSize frameSize = parseSize(parser.value(sizeOption));
+    QSize targetSize = parser.isSet(targetOption) ? parseSize(parser.value(targetOption)) : frameSize;
+    int frames = qMax(1, parser.value(framesOption).toInt());
+
+    RenderBenchmark benchmark;
+    if (!benchmark.initialize(frameSize, targetSize)) {
+        return 1;
+    }
+    if (!benchmark.run(frames, parser.value(changedOption).toInt(), parser.isSet(readBackOption))) {
+        return 1;
+    }
+    QByteArray json = QJsonDocument(benchmark.report()).toJson(QJsonDocument::Compact);
+    fprintf(stdout, "%s\n", json.constData());
+    fflush(stdout);
+    return 0;
+}
+
+void RenderBenchmark::fillFrame(int index, int changedPercent)
+{
+    const int width = m_frameSize.width();
+    const int height = m_frameSize.height();
+    quint8 *dataY = reinterpret_cast<quint8 *>(m_planes.data());
+    quint8 *dataU = dataY + width * height;
+    quint8 *dataV = dataU + (width / 2) * (height / 2);
+
+    // a band of rows moving down, like scrolling content
+    int rows = height * changedPercent / 100;
+    int start = (index * rows) % height;
+    for (int i = 0; i < rows; i++) {
+        int y = (start + i) % height;
+        quint8 *row = dataY + y * width;
+        for (int x = 0; x < width; x++) {
+            row[x] = static_cast<quint8>(16 + ((x + y + index * 8) % 220));
+        }
+        if (y % 2 || y / 2 >= height / 2) {
+            continue;
+        }
+        quint8 *rowU = dataU + (y / 2) * (width / 2);
+        quint8 *rowV = dataV + (y / 2) * (width / 2);
+        for (int x = 0; x < width / 2; x++) {
+            rowU[x] = static_cast<quint8>(16 + ((x * 2 + index * 4) % 224));
+            rowV[x] = static_cast<quint8>(16 + ((y + index * 4) % 224));
+        }
+    }
+}
+
+void RenderBenchmark::renderFrame(bool readBack, bool measure)
+{
+    const quint8 *pixels[3];
+    pixels[0] = reinterpret_cast<const quint8 *>(m_planes.constData());
+    pixels[1] = pixels[0] + m_frameSize.width() * m_frameSize.height();
+    pixels[2] = pixels[1] + (m_frameSize.width() / 2) * (m_frameSize.height() / 2);
+    const quint32 strides[3]
+        = { static_cast<quint32>(m_frameSize.width()), static_cast<quint32>(m_frameSize.width() / 2), static_cast<quint32>(m_frameSize.width() / 2) };
+
+    QElapsedTimer timer;
+    timer.start();
+    m_textures.update(pixels, strides);
+    glFinish();
+    qint64 uploadNsecs = timer.nsecsElapsed();
+
+    timer.restart();
+    m_fbo->bind();
+    glViewport(0, 0, m_targetSize.width(), m_targetSize.height());
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    m_renderer.render(m_textures);
+    glFinish();
+    qint64 drawNsecs = timer.nsecsElapsed();
+
+    qint64 readBackNsecs = 0;
+    if (readBack) {
+        timer.restart();
+        glReadPixels(0, 0, m_targetSize.width(), m_targetSize.height(), GL_RGBA, GL_UNSIGNED_BYTE, m_readBackPixels.data());
+        readBackNsecs = timer.nsecsElapsed();
+    }
+    m_fbo->release();
+
+    if (measure) {
+        m_uploadNsecs.append(uploadNsecs);
+        m_drawNsecs.append(drawNsecs);
+        m_readBackNsecs.append(readBackNsecs);
+    }
+}
+
+QJsonObject RenderBenchmark::summarize(QVector<qint64> nsecs)
+{
+    QJsonObject summary;
+    if (nsecs.isEmpty()) {
+        return summary;
+    }
+    std::sort(nsecs.begin(), nsecs.end());
+    qint64 total = 0;
+    for (qint64 value : nsecs) {
+        total += value;
+    }
+    auto ms = [](qint64 value) { return value / 1000000.0; };
+    summary["avgMs"] = ms(total / nsecs.size());
+    summary["minMs"] = ms(nsecs.first());
+    summary["p50Ms"] = ms(nsecs[nsecs.size() / 2]);
+    summary["p95Ms"] = ms(nsecs[qMin(nsecs.size() - 1, nsecs.size() * 95 / 100)]);
+    summary["maxMs"] = ms(nsecs.last());
+    return summary;
+}
@@ -0,0 +1,68 @@
+#ifndef RENDERBENCHMARK_H
+#define RENDERBENCHMARK_H
+#include <QByteArray>
+#include <QJsonObject>
+#include <QOpenGLFunctions>
+#include <QSize>
+#include <QStringList>
+#include <QVector>
+
+#include "yuvrenderer.h"
+#include "yuvtextures.h"
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+
+// Runs the upload and draw code of the video widget into an FBO of an
+// offscreen surface, no window needed (e.g. Mesa llvmpipe under xvfb-run
+// or -platform offscreen), and measures each step of every frame. glFinish() after each
+// step attributes the GL work to it, so the numbers are slower than the
+// pipelined widget but comparable between runs.
+class RenderBenchmark : protected QOpenGLFunctions
+{
+public:
+    RenderBenchmark();
+    virtual ~RenderBenchmark();
+
+    // false when there is no usable OpenGL
+    bool initialize(const QSize &frameSize, const QSize &targetSize);
+    void deInitialize();
+    // changedPercent of the rows change every frame, readBack copies the
+    // result to memory like a screenshot would, otherwise it is discarded
+    bool run(int frames, int changedPercent, bool readBack);
+    // timings in milliseconds and the GL implementation
+    QJsonObject report() const;
+
+    // --render-benchmark [--size WxH] [--target WxH] [--frames N] [--changed PERCENT] [--readback]
+    // prints the report as json on stdout, returns the process exit code
+    static int exec(const QStringList &arguments);
+
+private:
+    void fillFrame(int index, int changedPercent);
+    void renderFrame(bool readBack, bool measure);
+    static QJsonObject summarize(QVector<qint64> nsecs);
+
+private:
+    QOffscreenSurface *m_surface = Q_NULLPTR;
+    QOpenGLContext *m_context = Q_NULLPTR;
+    QOpenGLFramebufferObject *m_fbo = Q_NULLPTR;
+    YUVRenderer m_renderer;
+    YUVTextures m_textures;
+
+    QString m_glRenderer;
+    QString m_glVersion;
+    QSize m_frameSize;
+    QSize m_targetSize;
+    // synthetic YUV420P frame, tightly packed
+    QByteArray m_planes;
+    QByteArray m_readBackPixels;
+
+    int m_changedPercent = 100;
+    bool m_readBack = false;
+    QVector<qint64> m_uploadNsecs;
+    QVector<qint64> m_drawNsecs;
+    QVector<qint64> m_readBackNsecs;
+};
+
+#endif // RENDERBENCHMARK_H
@@ -0,0 +1,276 @@
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YUVCONVERTER_SSE2
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define YUVCONVERTER_AVX2
+#define YUVCONVERTER_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#define YUVCONVERTER_AVX2
+#define YUVCONVERTER_TARGET_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YUVCONVERTER_NEON
+#endif
+
+#include "yuvconverter.h"
+
+// BT.709 limited range, the coefficients of the shader scaled by 64:
+// 1.1644 -> 74.5, 1.7927 -> 115, 0.2132 -> 14, 0.5329 -> 34, 2.1124 -> 135
+// (y - 16) * 74.5 + 128 * 135 may exceed 16 bits, the simd versions use
+// saturating adds, the result is clamped to 255 anyway
+
+typedef void (*ConvertRow)(const quint8 *y, const quint8 *u, const quint8 *v, quint32 *dst, int width);
+
+static inline quint8 clampByte(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+static void convertRowScalar(const quint8 *y, const quint8 *u, const quint8 *v, quint32 *dst, int width)
+{
+    for (int x = 0; x < width; x++) {
+        int c = y[x] - 16;
+        c = c * 74 + (c >> 1) + 32;
+        int d = u[x] - 128;
+        int e = v[x] - 128;
+        quint32 r = clampByte((c + 115 * e) >> 6);
+        quint32 g = clampByte((c - 14 * d - 34 * e) >> 6);
+        quint32 b = clampByte((c + 135 * d) >> 6);
+        dst[x] = 0xff000000 | (r << 16) | (g << 8) | b;
+    }
+}
+
+#if defined(YUVCONVERTER_SSE2)
+static void convertRowSse2(const quint8 *y, const quint8 *u, const quint8 *v, quint32 *dst, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi16(255);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i c = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y + x)), zero), _mm_set1_epi16(16));
+        __m128i d = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x)), zero), _mm_set1_epi16(128));
+        __m128i e = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x)), zero), _mm_set1_epi16(128));
+        c = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(c, _mm_set1_epi16(74)), _mm_srai_epi16(c, 1)), _mm_set1_epi16(32));
+
+        __m128i r = _mm_srai_epi16(_mm_adds_epi16(c, _mm_mullo_epi16(e, _mm_set1_epi16(115))), 6);
+        __m128i g = _mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(c, _mm_mullo_epi16(d, _mm_set1_epi16(14))), _mm_mullo_epi16(e, _mm_set1_epi16(34))), 6);
+        __m128i b = _mm_srai_epi16(_mm_adds_epi16(c, _mm_mullo_epi16(d, _mm_set1_epi16(135))), 6);
+
+        // bgra bytes
+        __m128i bg = _mm_packus_epi16(b, g);
+        __m128i ra = _mm_packus_epi16(r, alpha);
+        bg = _mm_unpacklo_epi8(bg, _mm_srli_si128(bg, 8));
+        ra = _mm_unpacklo_epi8(ra, _mm_srli_si128(ra, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x + 4), _mm_unpackhi_epi16(bg, ra));
+    }
+    convertRowScalar(y + x, u + x, v + x, dst + x, width - x);
+}
+#endif
+
+#if defined(YUVCONVERTER_AVX2)
+static YUVCONVERTER_TARGET_AVX2 void convertRowAvx2(const quint8 *y, const quint8 *u, const quint8 *v, quint32 *dst, int width)
+{
+    const __m256i alpha = _mm256_set1_epi16(255);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i c = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x))), _mm256_set1_epi16(16));
+        __m256i d = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(u + x))), _mm256_set1_epi16(128));
+        __m256i e = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(v + x))), _mm256_set1_epi16(128));
+        c = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(c, _mm256_set1_epi16(74)), _mm256_srai_epi16(c, 1)), _mm256_set1_epi16(32));
+
+        __m256i r = _mm256_srai_epi16(_mm256_adds_epi16(c, _mm256_mullo_epi16(e, _mm256_set1_epi16(115))), 6);
+        __m256i g = _mm256_srai_epi16(
+            _mm256_subs_epi16(_mm256_subs_epi16(c, _mm256_mullo_epi16(d, _mm256_set1_epi16(14))), _mm256_mullo_epi16(e, _mm256_set1_epi16(34))), 6);
+        __m256i b = _mm256_srai_epi16(_mm256_adds_epi16(c, _mm256_mullo_epi16(d, _mm256_set1_epi16(135))), 6);
+
+        // bgra bytes, the unpacks work per 128 bit lane: pixels 0-3 and 8-11, 4-7 and 12-15
+        __m256i bg = _mm256_packus_epi16(b, g);
+        __m256i ra = _mm256_packus_epi16(r, alpha);
+        bg = _mm256_unpacklo_epi8(bg, _mm256_srli_si256(bg, 8));
+        ra = _mm256_unpacklo_epi8(ra, _mm256_srli_si256(ra, 8));
+        __m256i lo = _mm256_unpacklo_epi16(bg, ra);
+        __m256i hi = _mm256_unpackhi_epi16(bg, ra);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    convertRowSse2(y + x, u + x, v + x, dst + x, width - x);
+}
+
+static bool cpuHasAvx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    // osxsave and avx, the os must also save the ymm registers
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#endif
+}
+#endif
+
+#if defined(YUVCONVERTER_NEON)
+static void convertRowNeon(const quint8 *y, const quint8 *u, const quint8 *v, quint32 *dst, int width)
+{
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        int16x8_t c = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y + x))), vdupq_n_s16(16));
+        int16x8_t d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x))), vdupq_n_s16(128));
+        int16x8_t e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v + x))), vdupq_n_s16(128));
+        c = vaddq_s16(vaddq_s16(vmulq_n_s16(c, 74), vshrq_n_s16(c, 1)), vdupq_n_s16(32));
+
+        uint8x8x4_t bgra;
+        bgra.val[0] = vqshrun_n_s16(vqaddq_s16(c, vmulq_n_s16(d, 135)), 6);
+        bgra.val[1] = vqshrun_n_s16(vqsubq_s16(vqsubq_s16(c, vmulq_n_s16(d, 14)), vmulq_n_s16(e, 34)), 6);
+        bgra.val[2] = vqshrun_n_s16(vqaddq_s16(c, vmulq_n_s16(e, 115)), 6);
+        bgra.val[3] = vdup_n_u8(255);
+        vst4_u8(reinterpret_cast<uint8_t *>(dst + x), bgra);
+    }
+    convertRowScalar(y + x, u + x, v + x, dst + x, width - x);
+}
+#endif
+
+static ConvertRow convertRowFunction()
+{
+#if defined(YUVCONVERTER_AVX2)
+    if (cpuHasAvx2()) {
+        return convertRowAvx2;
+    }
+#endif
+#if defined(YUVCONVERTER_SSE2)
+    return convertRowSse2;
+#elif defined(YUVCONVERTER_NEON)
+    return convertRowNeon;
+#else
+    return convertRowScalar;
+#endif
+}
+
+YUVConverter::YUVConverter() {}
+
+YUVConverter::~YUVConverter() {}
+
+void YUVConverter::convert(const QSize &frameSize, const quint8 *const pixels[3], const quint32 strides[3], QImage &image)
+{
+    // chosen once, by the cpu we run on
+    static const ConvertRow convertRow = convertRowFunction();
+
+    if (frameSize.width() < 2 || frameSize.height() < 2 || image.isNull()) {
+        return;
+    }
+
+    const QSize planeSizes[2] = { frameSize, frameSize / 2 };
+    if (m_frameSize != frameSize || m_imageSize != image.size()) {
+        m_frameSize = frameSize;
+        m_imageSize = image.size();
+        for (int i = 0; i < 2; i++) {
+            buildTaps(m_xTaps[i], planeSizes[i].width(), image.width());
+            buildTaps(m_yTaps[i], planeSizes[i].height(), image.height());
+        }
+        for (int i = 0; i < 3; i++) {
+            m_blendRows[i].resize(planeSizes[i ? 1 : 0].width());
+            m_scaledRows[i].resize(image.width());
+        }
+    }
+
+    const int width = image.width();
+    const quint8 *rows[3] = {};
+    const Tap *chromaTap = Q_NULLPTR;
+    for (int y = 0; y < image.height(); y++) {
+        for (int i = 0; i < 3; i++) {
+            int p = i ? 1 : 0;
+            const Tap &tap = m_yTaps[p][y];
+            // consecutive rows often share the chroma row when upscaling
+            if (p && chromaTap && chromaTap->index0 == tap.index0 && chromaTap->weight == tap.weight) {
+                continue;
+            }
+            const quint8 *row = blendRows(pixels[i], strides[i], tap, planeSizes[p].width(), m_blendRows[i].data());
+            rows[i] = planeSizes[p].width() == width ? row : scaleRow(row, m_xTaps[p], m_scaledRows[i].data());
+        }
+        chromaTap = &m_yTaps[1][y];
+        convertRow(rows[0], rows[1], rows[2], reinterpret_cast<quint32 *>(image.scanLine(y)), width);
+    }
+}
+
+void YUVConverter::buildTaps(std::vector<Tap> &taps, int srcSize, int dstSize)
+{
+    taps.resize(dstSize);
+    for (int i = 0; i < dstSize; i++) {
+        // source position of the center of the pixel, 7 bits fraction
+        qint64 pos = (qint64(2 * i + 1) * srcSize * 128) / (2 * dstSize) - 64;
+        pos = std::max<qint64>(pos, 0);
+        Tap &tap = taps[i];
+        tap.index0 = static_cast<int>(pos >> 7);
+        tap.weight = static_cast<int>(pos & 127);
+        if (tap.index0 >= srcSize - 1) {
+            tap.index0 = srcSize - 1;
+            tap.weight = 0;
+        }
+        tap.index1 = std::min(tap.index0 + 1, srcSize - 1);
+    }
+}
+
+const quint8 *YUVConverter::blendRows(const quint8 *src, quint32 stride, const Tap &tap, int width, quint8 *buffer)
+{
+    const quint8 *row0 = src + tap.index0 * stride;
+    if (tap.weight == 0) {
+        return row0;
+    }
+    const quint8 *row1 = src + tap.index1 * stride;
+
+    int x = 0;
+#if defined(YUVCONVERTER_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weight = _mm_set1_epi16(tap.weight);
+    for (; x + 16 <= width; x += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x));
+        __m128i aLo = _mm_unpacklo_epi8(a, zero);
+        __m128i aHi = _mm_unpackhi_epi8(a, zero);
+        __m128i lo = _mm_add_epi16(aLo, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(b, zero), aLo), weight), 7));
+        __m128i hi = _mm_add_epi16(aHi, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(b, zero), aHi), weight), 7));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(buffer + x), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(YUVCONVERTER_NEON)
+    const int16x8_t weight = vdupq_n_s16(tap.weight);
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t a = vld1q_u8(row0 + x);
+        uint8x16_t b = vld1q_u8(row1 + x);
+        int16x8_t aLo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(a)));
+        int16x8_t aHi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(a)));
+        int16x8_t lo = vaddq_s16(aLo, vshrq_n_s16(vmulq_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(b))), aLo), weight), 7));
+        int16x8_t hi = vaddq_s16(aHi, vshrq_n_s16(vmulq_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(b))), aHi), weight), 7));
+        vst1q_u8(buffer + x, vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi)));
+    }
+#endif
+    for (; x < width; x++) {
+        buffer[x] = static_cast<quint8>(row0[x] + (((row1[x] - row0[x]) * tap.weight) >> 7));
+    }
+    return buffer;
+}
+
+const quint8 *YUVConverter::scaleRow(const quint8 *src, const std::vector<Tap> &taps, quint8 *buffer)
+{
+    const int width = static_cast<int>(taps.size());
+    for (int x = 0; x < width; x++) {
+        const Tap &tap = taps[x];
+        buffer[x] = static_cast<quint8>(src[tap.index0] + (((src[tap.index1] - src[tap.index0]) * tap.weight) >> 7));
+    }
+    return buffer;
+}
@@ -0,0 +1,45 @@
+#ifndef YUVCONVERTER_H
+#define YUVCONVERTER_H
+
+#include <vector>
+#include <QImage>
+#include <QSize>
+
+// Converts a YUV420P frame (BT.709 limited range, like the shader) into a
+// QImage::Format_RGB32 image of any size, with bilinear scaling. Each output
+// row is resampled and converted in one go, there is no full size RGB copy.
+// The row conversion uses AVX2 when the cpu has it, otherwise SSE2 or NEON.
+class YUVConverter
+{
+public:
+    YUVConverter();
+    virtual ~YUVConverter();
+
+    // image must be allocated with the wanted size and format
+    void convert(const QSize &frameSize, const quint8 *const pixels[3], const quint32 strides[3], QImage &image);
+
+private:
+    struct Tap
+    {
+        int index0;
+        int index1;
+        // weight of index1, 0-128
+        int weight;
+    };
+
+    static void buildTaps(std::vector<Tap> &taps, int srcSize, int dstSize);
+    static const quint8 *blendRows(const quint8 *src, quint32 stride, const Tap &tap, int width, quint8 *buffer);
+    static const quint8 *scaleRow(const quint8 *src, const std::vector<Tap> &taps, quint8 *buffer);
+
+private:
+    QSize m_frameSize;
+    QSize m_imageSize;
+    // horizontal taps of the luma and chroma planes, vertical of luma and chroma
+    std::vector<Tap> m_xTaps[2];
+    std::vector<Tap> m_yTaps[2];
+    // vertically blended source rows and horizontally scaled rows
+    std::vector<quint8> m_blendRows[3];
+    std::vector<quint8> m_scaledRows[3];
+};
+
+#endif // YUVCONVERTER_H
@@ -0,0 +1,165 @@
+#include <QCoreApplication>
+
+#include "yuvrenderer.h"
+#include "yuvtextures.h"
+
+// 存储顶点坐标和纹理坐标
+// 存在一起缓存在vbo
+// 使用glVertexAttribPointer指定访问方式即可
+static const GLfloat coordinate[] = {
+    // 顶点坐标，存储4个xyz坐标
+    // 坐标范围为[-1,1],中心点为 0,0
+    // 二维图像z始终为0
+    // GL_TRIANGLE_STRIP的绘制方式：
+    // 使用前3个坐标绘制一个三角形，使用后三个坐标绘制一个三角形，正好为一个矩形
+    // x     y     z
+    -1.0f,
+    -1.0f,
+    0.0f,
+    1.0f,
+    -1.0f,
+    0.0f,
+    -1.0f,
+    1.0f,
+    0.0f,
+    1.0f,
+    1.0f,
+    0.0f,
+
+    // 纹理坐标，存储4个xy坐标
+    // 坐标范围为[0,1],左下角为 0,0
+    0.0f,
+    1.0f,
+    1.0f,
+    1.0f,
+    0.0f,
+    0.0f,
+    1.0f,
+    0.0f
+};
+
+// 顶点着色器
+static const QString s_vertShader = R"(
+    attribute vec3 vertexIn;    // xyz顶点坐标
+    attribute vec2 textureIn;   // xy纹理坐标
+    varying vec2 textureOut;    // 传递给片段着色器的纹理坐标
+    void main(void)
+    {
+        gl_Position = vec4(vertexIn, 1.0);  // 1.0表示vertexIn是一个顶点位置
+        textureOut = textureIn; // 纹理坐标直接传递给片段着色器
+    }
+)";
+
+// 片段着色器
+static const QString s_fragShader = R"(
+    varying vec2 textureOut;        // 由顶点着色器传递过来的纹理坐标
+    uniform sampler2D textureY;     // uniform 纹理单元，利用纹理单元可以使用多个纹理
+    uniform sampler2D textureU;     // sampler2D是2D采样器
+    uniform sampler2D textureV;     // 声明yuv三个纹理单元
+    void main(void)
+    {
+        vec3 yuv;
+        vec3 rgb;
+
+        // SDL2 BT709_SHADER_CONSTANTS
+        // https://github.com/spurious/SDL-mirror/blob/4ddd4c445aa059bb127e101b74a8c5b59257fbe2/src/render/opengl/SDL_shaders_gl.c#L102
+        const vec3 Rcoeff = vec3(1.1644,  0.000,  1.7927);
+        const vec3 Gcoeff = vec3(1.1644, -0.2132, -0.5329);
+        const vec3 Bcoeff = vec3(1.1644,  2.1124,  0.000);
+
+        // 根据指定的纹理textureY和坐标textureOut来采样
+        yuv.x = texture2D(textureY, textureOut).r;
+        yuv.y = texture2D(textureU, textureOut).r - 0.5;
+        yuv.z = texture2D(textureV, textureOut).r - 0.5;
+
+        // 采样完转为rgb
+        // 减少一些亮度
+        yuv.x = yuv.x - 0.0625;
+        rgb.r = dot(yuv, Rcoeff);
+        rgb.g = dot(yuv, Gcoeff);
+        rgb.b = dot(yuv, Bcoeff);
+        // 输出颜色值
+        gl_FragColor = vec4(rgb, 1.0);
+    }
+)";
+
+YUVRenderer::YUVRenderer() {}
+
+YUVRenderer::~YUVRenderer() {}
+
+void YUVRenderer::initialize()
+{
+    if (m_initialized) {
+        return;
+    }
+    initializeOpenGLFunctions();
+
+    // 顶点缓冲对象初始化
+    m_vbo.create();
+    m_vbo.bind();
+    m_vbo.allocate(coordinate, sizeof(coordinate));
+    m_vbo.release();
+    initShader();
+    m_initialized = true;
+}
+
+void YUVRenderer::deInitialize()
+{
+    if (!m_initialized) {
+        return;
+    }
+    m_vbo.destroy();
+    m_shaderProgram.removeAllShaders();
+    m_initialized = false;
+}
+
+void YUVRenderer::render(YUVTextures &textures)
+{
+    if (!m_initialized) {
+        return;
+    }
+
+    m_shaderProgram.bind();
+    if (textures.bind()) {
+        // the attributes are set for every draw, the VBO binding may have
+        // been changed meanwhile (no VAO on GLES2)
+        m_vbo.bind();
+        // 指定顶点坐标在vbo中的访问方式
+        // 参数解释：顶点坐标在shader中的参数名称，顶点坐标为float，起始偏移为0，顶点坐标类型为vec3，步幅为3个float
+        m_shaderProgram.setAttributeBuffer("vertexIn", GL_FLOAT, 0, 3, 3 * sizeof(float));
+        // 启用顶点属性
+        m_shaderProgram.enableAttributeArray("vertexIn");
+
+        // 指定纹理坐标在vbo中的访问方式
+        // 参数解释：纹理坐标在shader中的参数名称，纹理坐标为float，起始偏移为12个float（跳过前面存储的12个顶点坐标），纹理坐标类型为vec2，步幅为2个float
+        m_shaderProgram.setAttributeBuffer("textureIn", GL_FLOAT, 12 * sizeof(float), 2, 2 * sizeof(float));
+        m_shaderProgram.enableAttributeArray("textureIn");
+
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        m_vbo.release();
+        glActiveTexture(GL_TEXTURE0);
+    }
+    m_shaderProgram.release();
+}
+
+void YUVRenderer::initShader()
+{
+    QString fragShader = s_fragShader;
+    // opengles的float、int等要手动指定精度
+    if (QCoreApplication::testAttribute(Qt::AA_UseOpenGLES)) {
+        fragShader.prepend(R"(
+                             precision mediump int;
+                             precision mediump float;
+                             )");
+    }
+    m_shaderProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, s_vertShader);
+    m_shaderProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, fragShader);
+    m_shaderProgram.link();
+    m_shaderProgram.bind();
+
+    // 关联片段着色器中的纹理单元和opengl中的纹理单元（opengl一般提供16个纹理单元）
+    m_shaderProgram.setUniformValue("textureY", 0);
+    m_shaderProgram.setUniformValue("textureU", 1);
+    m_shaderProgram.setUniformValue("textureV", 2);
+    m_shaderProgram.release();
+}
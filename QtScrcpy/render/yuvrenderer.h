@@ -0,0 +1,35 @@
+#ifndef YUVRENDERER_H
+#define YUVRENDERER_H
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+
+class YUVTextures;
+
+// YUV to RGB shader program, shared by all the streams drawn in a GL context.
+// The methods must be called with the GL context current.
+class YUVRenderer : protected QOpenGLFunctions
+{
+public:
+    YUVRenderer();
+    virtual ~YUVRenderer();
+
+    void initialize();
+    void deInitialize();
+    // draw the textures in the whole current viewport
+    void render(YUVTextures &textures);
+
+private:
+    void initShader();
+
+private:
+    bool m_initialized = false;
+
+    // 顶点缓冲对象(Vertex Buffer Objects, VBO)：默认即为VertexBuffer(GL_ARRAY_BUFFER)类型
+    QOpenGLBuffer m_vbo;
+
+    // 着色器程序：编译链接着色器
+    QOpenGLShaderProgram m_shaderProgram;
+};
+
+#endif // YUVRENDERER_H
@@ -0,0 +1,387 @@
+#include <cstring>
+#include <QOpenGLContext>
+
+#include "yuvtextures.h"
+
+YUVTextures::YUVTextures() {}
+
+YUVTextures::~YUVTextures() {}
+
+void YUVTextures::initialize()
+{
+    if (m_initialized) {
+        return;
+    }
+    initializeOpenGLFunctions();
+    // GL_UNPACK_ROW_LENGTH: OpenGL, OpenGL ES 3.0 / GL_EXT_unpack_subimage
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    m_subRectSupported = !ctx->isOpenGLES() || ctx->format().majorVersion() >= 3 || ctx->hasExtension("GL_EXT_unpack_subimage");
+    // glGenerateMipmap of NPOT textures: OpenGL 3.0 / GL_ARB_framebuffer_object, OpenGL ES 3.0
+    if (ctx->isOpenGLES()) {
+        m_mipmapSupported = ctx->format().majorVersion() >= 3;
+    } else {
+        m_mipmapSupported = ctx->format().majorVersion() >= 3 || ctx->hasExtension("GL_ARB_framebuffer_object");
+    }
+    initPbos();
+    m_initialized = true;
+}
+
+void YUVTextures::deInitialize()
+{
+    if (!m_initialized) {
+        return;
+    }
+    deInitPbos();
+    deInitTextures();
+    m_needUpdate = m_frameSize.isValid();
+    m_initialized = false;
+}
+
+void YUVTextures::setFrameSize(const QSize &frameSize)
+{
+    if (m_frameSize != frameSize) {
+        m_frameSize = frameSize;
+        m_needUpdate = true;
+    }
+}
+
+const QSize &YUVTextures::frameSize() const
+{
+    return m_frameSize;
+}
+
+bool YUVTextures::update(const quint8 *const pixels[3], const quint32 strides[3])
+{
+    if (!checkTextures()) {
+        return false;
+    }
+
+    QSize sizes[3] = { m_frameSize, m_frameSize / 2, m_frameSize / 2 };
+    QRect frameRect(QPoint(0, 0), m_frameSize);
+    QVector<QRect> rects = m_dirtyTiles.update(m_frameSize, pixels, strides);
+    if (!rects.isEmpty() && !m_subRectSupported) {
+        rects = { frameRect };
+    }
+    quint64 frameBytes = 0;
+    quint64 uploadBytes = 0;
+    for (int i = 0; i < 3; i++) {
+        frameBytes += sizes[i].width() * sizes[i].height();
+        for (const QRect &rect : rects) {
+            QRect planeRect = DirtyTiles::planeRect(i, rect, sizes[i]);
+            uploadBytes += planeRect.width() * planeRect.height();
+        }
+    }
+    updateUploadStats(frameBytes, uploadBytes);
+    if (rects.isEmpty()) {
+        return false;
+    }
+
+    if (!m_pboSupported || !updateTexturesWithPbo(pixels, strides, rects)) {
+        for (const QRect &rect : rects) {
+            for (int i = 0; i < 3; i++) {
+                updateTexture(m_texture[i], i, pixels[i], strides[i], DirtyTiles::planeRect(i, rect, sizes[i]));
+            }
+        }
+    }
+    // generated once before the next draw, whatever the number of uploads
+    m_mipmapDirty = m_mipmapApplied;
+    return true;
+}
+
+bool YUVTextures::bind()
+{
+    if (!checkTextures()) {
+        return false;
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_texture[0]);
+    if (m_mipmapDirty) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_texture[1]);
+    if (m_mipmapDirty) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, m_texture[2]);
+    if (m_mipmapDirty) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    m_mipmapDirty = false;
+    return true;
+}
+
+quint64 YUVTextures::uploadBytesSavedPerSecond() const
+{
+    return m_uploadBytesSavedPerSecond;
+}
+
+void YUVTextures::setMipmap(bool mipmap)
+{
+    // applied by the next update() or bind()
+    m_mipmap = mipmap;
+}
+
+bool YUVTextures::mipmap() const
+{
+    return m_mipmap;
+}
+
+bool YUVTextures::checkTextures()
+{
+    if (!m_initialized) {
+        return false;
+    }
+    if (m_needUpdate) {
+        switchTextures();
+        m_needUpdate = false;
+    }
+    if (m_textureInited && m_mipmapApplied != (m_mipmap && m_mipmapSupported)) {
+        applyFilter();
+    }
+    return m_textureInited;
+}
+
+void YUVTextures::applyFilter()
+{
+    m_mipmapApplied = m_mipmap && m_mipmapSupported;
+    for (int i = 0; i < 3; i++) {
+        glBindTexture(GL_TEXTURE_2D, m_texture[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_mipmapApplied ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    }
+    // the chain must exist before sampling
+    m_mipmapDirty = m_mipmapApplied;
+}
+
+void YUVTextures::switchTextures()
+{
+    // keep the current textures for when their size comes back
+    if (m_textureInited) {
+        TextureSet current;
+        current.size = m_textureSize;
+        memcpy(current.texture, m_texture, sizeof(m_texture));
+        current.mipmapApplied = m_mipmapApplied;
+        m_texturePool.prepend(current);
+        memset(m_texture, 0, sizeof(m_texture));
+        m_textureInited = false;
+    }
+
+    if (!m_frameSize.isEmpty()) {
+        int index = pooledTextures(m_frameSize);
+        if (index >= 0) {
+            memcpy(m_texture, m_texturePool[index].texture, sizeof(m_texture));
+            m_mipmapApplied = m_texturePool[index].mipmapApplied;
+            m_texturePool.remove(index);
+        } else {
+            createTextures(m_texture, m_frameSize);
+            // created with GL_LINEAR, see applyFilter()
+            m_mipmapApplied = false;
+        }
+        m_textureSize = m_frameSize;
+        m_textureInited = true;
+        // pooled or new, the textures don't hold the last frame: the next one is uploaded entirely
+        m_dirtyTiles.reset();
+
+        // the other orientation too, the first rotation doesn't allocate either
+        QSize rotated = m_frameSize.transposed();
+        if (rotated != m_frameSize && pooledTextures(rotated) < 0) {
+            TextureSet set;
+            set.size = rotated;
+            createTextures(set.texture, rotated);
+            set.mipmapApplied = false;
+            m_texturePool.prepend(set);
+        }
+    }
+
+    while (m_texturePool.size() > s_texturePoolSize) {
+        glDeleteTextures(3, m_texturePool.last().texture);
+        m_texturePool.removeLast();
+    }
+}
+
+void YUVTextures::createTextures(GLuint texture[3], const QSize &size)
+{
+    QSize sizes[3] = { size, size / 2, size / 2 };
+    glGenTextures(3, texture);
+    for (int i = 0; i < 3; i++) {
+        glBindTexture(GL_TEXTURE_2D, texture[i]);
+        // 设置纹理缩放时的策略
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // 设置st方向上纹理超出坐标时的显示策略
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, sizes[i].width(), sizes[i].height(), 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+    }
+}
+
+int YUVTextures::pooledTextures(const QSize &size) const
+{
+    for (int i = 0; i < m_texturePool.size(); i++) {
+        if (m_texturePool[i].size == size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void YUVTextures::deInitTextures()
+{
+    if (QOpenGLFunctions::isInitialized(QOpenGLFunctions::d_ptr)) {
+        glDeleteTextures(3, m_texture);
+        for (const TextureSet &set : m_texturePool) {
+            glDeleteTextures(3, set.texture);
+        }
+    }
+
+    memset(m_texture, 0, sizeof(m_texture));
+    m_texturePool.clear();
+    m_textureSize = QSize();
+    m_textureInited = false;
+}
+
+void YUVTextures::updateTexture(GLuint texture, quint32 textureType, const quint8 *pixels, quint32 stride, const QRect &rect)
+{
+    Q_UNUSED(textureType)
+    if (!pixels || rect.isEmpty())
+        return;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    const quint8 *data = pixels + rect.y() * stride + rect.x();
+    if (m_subRectSupported) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(stride));
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x(), rect.y(), rect.width(), rect.height(), GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        return;
+    }
+
+    // GLES2: the rows of the source are padded, upload them one by one
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (stride == static_cast<quint32>(rect.width())) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x(), rect.y(), rect.width(), rect.height(), GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
+    } else {
+        for (int y = 0; y < rect.height(); y++) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x(), rect.y() + y, rect.width(), 1, GL_LUMINANCE, GL_UNSIGNED_BYTE, data + y * stride);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void YUVTextures::initPbos()
+{
+    // PBO: OpenGL 2.1 / GL_ARB_pixel_buffer_object, OpenGL ES 3.0
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (ctx->isOpenGLES()) {
+        m_pboSupported = ctx->format().majorVersion() >= 3;
+    } else {
+        m_pboSupported = ctx->format().version() >= qMakePair(2, 1) || ctx->hasExtension("GL_ARB_pixel_buffer_object");
+    }
+    if (!m_pboSupported) {
+        return;
+    }
+
+    for (int i = 0; i < s_pboCount; i++) {
+        m_pbo[i] = QOpenGLBuffer(QOpenGLBuffer::PixelUnpackBuffer);
+        m_pbo[i].setUsagePattern(QOpenGLBuffer::StreamDraw);
+        if (!m_pbo[i].create()) {
+            deInitPbos();
+            m_pboSupported = false;
+            return;
+        }
+    }
+}
+
+void YUVTextures::deInitPbos()
+{
+    for (int i = 0; i < s_pboCount; i++) {
+        m_pbo[i].destroy();
+    }
+    m_pboIndex = 0;
+}
+
+bool YUVTextures::updateTexturesWithPbo(const quint8 *const pixels[3], const quint32 strides[3], const QVector<QRect> &rects)
+{
+    if (!pixels[0] || !pixels[1] || !pixels[2]) {
+        return false;
+    }
+
+    // rects of every plane, packed one after the other without padding
+    QSize sizes[3] = { m_frameSize, m_frameSize / 2, m_frameSize / 2 };
+    QVector<QRect> planeRects[3];
+    int total = 0;
+    for (int i = 0; i < 3; i++) {
+        for (const QRect &rect : rects) {
+            QRect planeRect = DirtyTiles::planeRect(i, rect, sizes[i]);
+            planeRects[i].append(planeRect);
+            total += planeRect.width() * planeRect.height();
+        }
+    }
+
+    // the previous frames may still be transferring from the other buffers of the ring
+    QOpenGLBuffer &pbo = m_pbo[m_pboIndex];
+    m_pboIndex = (m_pboIndex + 1) % s_pboCount;
+    if (!pbo.bind()) {
+        return false;
+    }
+    // orphan the storage: the driver gives a new one instead of waiting for
+    // the pending transfer of the old one
+    pbo.allocate(total);
+    quint8 *dst = static_cast<quint8 *>(pbo.mapRange(0, total, QOpenGLBuffer::RangeWrite | QOpenGLBuffer::RangeInvalidateBuffer));
+    if (!dst) {
+        dst = static_cast<quint8 *>(pbo.map(QOpenGLBuffer::WriteOnly));
+    }
+    if (!dst) {
+        pbo.release();
+        m_pboSupported = false;
+        return false;
+    }
+
+    int offset = 0;
+    for (int i = 0; i < 3; i++) {
+        for (const QRect &rect : planeRects[i]) {
+            for (int y = rect.top(); y <= rect.bottom(); y++) {
+                memcpy(dst + offset, pixels[i] + y * strides[i] + rect.x(), rect.width());
+                offset += rect.width();
+            }
+        }
+    }
+    pbo.unmap();
+
+    // the copy into the PBO above still costs the caller thread as much as a
+    // direct upload; only the copy to the textures is done by the GPU,
+    // glTexSubImage2D returns immediately
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    offset = 0;
+    for (int i = 0; i < 3; i++) {
+        glBindTexture(GL_TEXTURE_2D, m_texture[i]);
+        for (const QRect &rect : planeRects[i]) {
+            if (rect.isEmpty()) {
+                continue;
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x(), rect.y(), rect.width(), rect.height(), GL_LUMINANCE, GL_UNSIGNED_BYTE,
+                            reinterpret_cast<const void *>(static_cast<quintptr>(offset)));
+            offset += rect.width() * rect.height();
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    pbo.release();
+    return true;
+}
+
+void YUVTextures::updateUploadStats(quint64 frameBytes, quint64 uploadBytes)
+{
+    if (!m_uploadStatsTimer.isValid()) {
+        m_uploadStatsTimer.start();
+    }
+    m_uploadBytesSaved += frameBytes - uploadBytes;
+    qint64 elapsed = m_uploadStatsTimer.elapsed();
+    if (elapsed >= 1000) {
+        m_uploadBytesSavedPerSecond = m_uploadBytesSaved * 1000 / elapsed;
+        m_uploadBytesSaved = 0;
+        m_uploadStatsTimer.restart();
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef YUVTEXTURES_H
+#define YUVTEXTURES_H
+#include <QElapsedTimer>
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QSize>
+
+#include "dirtytiles.h"
+
+// YUV420P textures of one video stream and their upload path.
+// Except frameSize(), the methods must be called with the GL context current.
+class YUVTextures : protected QOpenGLFunctions
+{
+public:
+    YUVTextures();
+    virtual ~YUVTextures();
+
+    void initialize();
+    void deInitialize();
+
+    // the textures of the new size are taken from the pool (or created) by
+    // the next update() or bind()
+    void setFrameSize(const QSize &frameSize);
+    const QSize &frameSize() const;
+    // upload the changed areas, false when nothing changed
+    bool update(const quint8 *const pixels[3], const quint32 strides[3]);
+    // bind Y, U, V to the texture units 0, 1, 2
+    bool bind();
+    // bytes not uploaded thanks to the unchanged tiles, over the last second
+    quint64 uploadBytesSavedPerSecond() const;
+    // trilinear filtering with a mipmap chain regenerated after the uploads,
+    // better quality and texture cache use when the view is much smaller
+    void setMipmap(bool mipmap);
+    bool mipmap() const;
+
+private:
+    struct TextureSet
+    {
+        QSize size;
+        GLuint texture[3];
+        bool mipmapApplied;
+    };
+
+    bool checkTextures();
+    void applyFilter();
+    void switchTextures();
+    void createTextures(GLuint texture[3], const QSize &size);
+    int pooledTextures(const QSize &size) const;
+    void deInitTextures();
+    void updateTexture(GLuint texture, quint32 textureType, const quint8 *pixels, quint32 stride, const QRect &rect);
+    void initPbos();
+    void deInitPbos();
+    bool updateTexturesWithPbo(const quint8 *const pixels[3], const quint32 strides[3], const QVector<QRect> &rects);
+    void updateUploadStats(quint64 frameBytes, quint64 uploadBytes);
+
+private:
+    bool m_initialized = false;
+
+    // 视频帧尺寸
+    QSize m_frameSize = { -1, -1 };
+    bool m_needUpdate = false;
+    bool m_textureInited = false;
+
+    // YUV纹理，用于生成纹理贴图
+    GLuint m_texture[3] = { 0 };
+    QSize m_textureSize;
+    // 最近用过的其他尺寸的纹理（旋转后的尺寸、缩小显示的尺寸），尺寸切换时直接复用，不重新分配
+    static const int s_texturePoolSize = 4;
+    QVector<TextureSet> m_texturePool;
+
+    // 像素缓冲对象环(Pixel Buffer Objects, PBO)：三个平面在主线程拷贝到同一个PBO（拷贝开销不变），
+    // glTexSubImage2D从PBO异步上传，不等待GPU传输；GLES2不支持时直接从内存上传
+    static const int s_pboCount = 3;
+    QOpenGLBuffer m_pbo[s_pboCount];
+    int m_pboIndex = 0;
+    bool m_pboSupported = false;
+    // GL_UNPACK_ROW_LENGTH不支持时（GLES2且无GL_EXT_unpack_subimage）只能整帧逐行上传
+    bool m_subRectSupported = false;
+
+    // mipmap（需要OpenGL 3.0或GLES3，GLES2不支持非2的幂尺寸纹理的mipmap）
+    bool m_mipmapSupported = false;
+    bool m_mipmap = false;
+    bool m_mipmapApplied = false;
+    bool m_mipmapDirty = false;
+
+    // 只上传变化的区域，画面不变时不上传也不重绘
+    DirtyTiles m_dirtyTiles;
+    quint64 m_uploadBytesSaved = 0;
+    quint64 m_uploadBytesSavedPerSecond = 0;
+    QElapsedTimer m_uploadStatsTimer;
+};
+
+#endif // YUVTEXTURES_H
@@ -8,6 +8,7 @@
 #include <QTimer>
 
 #include "config.h"
+#include "devicewall.h"
 #include "dialog.h"
 #include "devicefilebrowser.h"
 #include "ui_dialog.h"
@@ -142,6 +143,10 @@ Dialog::~Dialog()
     qDebug() << "~Dialog()";
     updateBootConfig(false);
     qsc::IDeviceManage::getInstance().disconnectAllDevice();
+    if (m_deviceWall) {
+        m_deviceWall->close();
+        m_deviceWall->deleteLater();
+    }
     delete ui;
 }
 
@@ -359,6 +364,10 @@ void Dialog::on_startServerBtn_clicked()
     params.useReverse = ui->useReverseCheck->isChecked();
     params.display = !ui->notDisplayCheck->isChecked();
     params.renderExpiredFrames = Config::getInstance().getRenderExpiredFrames();
+    params.decoderThreadMode = Config::getInstance().getDecoderThreadMode();
+    params.decoderThreads = Config::getInstance().getDecoderThreads();
+    params.screenshotFormat = Config::getInstance().getScreenshotFormat();
+    params.screenshotQuality = Config::getInstance().getScreenshotQuality();
     if (ui->lockOrientationBox->currentIndex() > 0) {
         params.captureOrientationLock = 1;
         params.captureOrientation = (ui->lockOrientationBox->currentIndex() - 1) * 90;
@@ -367,6 +376,13 @@ void Dialog::on_startServerBtn_clicked()
     params.recordFile = ui->recordScreenCheck->isChecked();
     params.recordPath = ui->recordPathEdt->text().trimmed();
     params.recordFileFormat = ui->formatBox->currentText().trimmed();
+    params.recordSegmented = Config::getInstance().getRecordSegmented();
+    params.recordSegmentDuration = static_cast<quint32>(qMax(Config::getInstance().getRecordSegmentDuration(), 0));
+    params.recordSegmentSize = static_cast<quint32>(qMax(Config::getInstance().getRecordSegmentSize(), 0));
+    params.replayDuration = static_cast<quint32>(qMax(Config::getInstance().getReplayDuration(), 0));
+    params.replaySize = static_cast<quint32>(qMax(Config::getInstance().getReplaySize(), 0));
+    params.recordQueueSize = static_cast<quint32>(qMax(Config::getInstance().getRecordQueueSize(), 0));
+    params.recordQueuePolicy = Config::getInstance().getRecordQueuePolicy();
     params.serverLocalPath = getServerPath();
     params.serverRemotePath = Config::getInstance().getServerPath();
     params.pushFilePath = Config::getInstance().getPushFilePath();
@@ -517,6 +533,20 @@ void Dialog::onDeviceConnected(bool success, const QString &serial, const QStrin
     if (!success) {
         return;
     }
+    // the device wall needs OpenGL, one window per device with the QPainter renderer
+    if (Config::getInstance().getDeviceWall() && 3 != Config::getInstance().getDesktopOpenGL()) {
+        // all the devices in one window and one GL context
+        if (!m_deviceWall) {
+            m_deviceWall = new DeviceWall();
+            m_deviceWall->setWindowTitle(Config::getInstance().getTitle());
+            m_deviceWall->resize(1280, 720);
+            // the tiles are usually much smaller than the streams
+            m_deviceWall->setMipmap(Config::getInstance().getMipmap());
+        }
+        qsc::IDeviceManage::getInstance().getDevice(serial)->registerDeviceObserver(m_deviceWall->addDevice(serial));
+        m_deviceWall->show();
+        return;
+    }
     auto videoForm = new VideoForm(ui->framelessCheck->isChecked(), Config::getInstance().getSkin(), ui->showToolbar->isChecked());
     videoForm->setSerial(serial);
 
@@ -566,6 +596,10 @@ void Dialog::onDeviceDisconnected(QString serial)
     if (!device) {
         return;
     }
+    if (m_deviceWall && m_deviceWall->observer(serial)) {
+        device->deRegisterDeviceObserver(m_deviceWall->observer(serial));
+        m_deviceWall->removeDevice(serial);
+    }
     auto data = device->getUserData();
     if (data) {
         VideoForm* vf = static_cast<VideoForm*>(data);
@@ -20,6 +20,7 @@ namespace Ui
 }
 
 class QYUVOpenGLWidget;
+class DeviceWall;
 class Dialog : public QWidget
 {
     Q_OBJECT
@@ -107,6 +108,7 @@ private:
     QAction *m_showWindow;
     QAction *m_quit;
     AudioOutput m_audioOutput;
+    QPointer<DeviceWall> m_deviceWall;
     QTimer m_autoUpdatetimer;
     QString m_selectedUploadFile;
     bool m_isFileTransferInProgress;
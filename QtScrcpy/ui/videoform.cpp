@@ -23,8 +23,10 @@
 #endif
 
 #include "config.h"
+#include "framedownscaler.h"
 #include "iconhelper.h"
 #include "qyuvopenglwidget.h"
+#include "qyuvsoftwarewidget.h"
 #include "toolform.h"
 #include "mousetap/mousetap.h"
 #include "ui_videoform.h"
@@ -44,6 +46,15 @@ VideoForm::VideoForm(bool framelessWindow, bool skin, bool showToolbar, QWidget
     if (framelessWindow) {
         setWindowFlags(windowFlags() | Qt::FramelessWindowHint);
     }
+
+    m_videoHiddenTimer = new QTimer(this);
+    m_videoHiddenTimer->setSingleShot(true);
+    m_videoHiddenTimer->setInterval(500);
+    connect(m_videoHiddenTimer, &QTimer::timeout, this, [this]() {
+        if (!isVideoShown()) {
+            setVideoVisible(false);
+        }
+    });
 }
 
 VideoForm::~VideoForm()
@@ -68,7 +79,17 @@ void VideoForm::initUI()
 #endif
     }
 
-    m_videoWidget = new QYUVOpenGLWidget();
+    if (3 == Config::getInstance().getDesktopOpenGL()) {
+        // no usable OpenGL, convert and scale on the cpu
+        QYUVSoftwareWidget *softwareWidget = new QYUVSoftwareWidget();
+        m_yuvWidget = softwareWidget;
+        m_videoWidget = softwareWidget;
+    } else {
+        QYUVOpenGLWidget *openGLWidget = new QYUVOpenGLWidget();
+        m_yuvWidget = openGLWidget;
+        m_videoWidget = openGLWidget;
+    }
+    m_yuvWidget->setMipmap(Config::getInstance().getMipmap());
     m_videoWidget->hide();
     ui->keepRatioWidget->setWidget(m_videoWidget);
     ui->keepRatioWidget->setWidthHeightRatio(m_widthHeightRatio);
@@ -152,7 +173,7 @@ void VideoForm::showFPS(bool show)
     m_fpsLabel->setVisible(show);
 }
 
-void VideoForm::updateRender(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV)
+void VideoForm::updateRender(const qsc::VideoFrame &frame)
 {
     if (m_videoWidget->isHidden()) {
         if (m_loadingWidget) {
@@ -161,9 +182,35 @@ void VideoForm::updateRender(int width, int height, uint8_t* dataY, uint8_t* dat
         m_videoWidget->show();
     }
 
-    updateShowSize(QSize(width, height));
-    m_videoWidget->setFrameSize(QSize(width, height));
-    m_videoWidget->updateTextures(dataY, dataU, dataV, linesizeY, linesizeU, linesizeV);
+    QSize frameSize(frame.width(), frame.height());
+    scheduleShowSize(frameSize);
+    m_yuvWidget->setFrameSize(frameSize);
+    int factor = downscaleFactor(frameSize);
+    if (factor > 1) {
+        // presented when downscaled, see onFrameDownscaled()
+        if (!m_downscaler) {
+            m_downscaler = new FrameDownscaler(this);
+            connect(m_downscaler, &FrameDownscaler::frameDownscaled, this, &VideoForm::onFrameDownscaled, Qt::QueuedConnection);
+        }
+        m_downscaler->push(frame, factor);
+        return;
+    }
+    m_yuvWidget->presentFrame(frame);
+}
+
+void VideoForm::scheduleShowSize(const QSize &newSize)
+{
+    m_pendingShowSize = newSize;
+    if (m_showSizePending || m_frameSize == newSize) {
+        return;
+    }
+    // resizing the window is slow (relayout, style sheet, GL surface), it is
+    // done after the frame instead of delaying it
+    m_showSizePending = true;
+    QTimer::singleShot(0, this, [this]() {
+        m_showSizePending = false;
+        updateShowSize(m_pendingShowSize);
+    });
 }
 
 void VideoForm::setSerial(const QString &serial)
@@ -526,13 +573,98 @@ bool VideoForm::isHost()
     return m_toolForm->isHost();
 }
 
+void VideoForm::onVideoFrame(const qsc::VideoFrame &frame)
+{
+    if (!m_videoVisible) {
+        // nothing uploaded, the last frame is shown when visible again
+        m_hiddenFrame = frame;
+        return;
+    }
+    // the refcounted frame can wait for the next refresh of the widget
+    updateRender(frame);
+}
+
+bool VideoForm::isVideoShown()
+{
+    // the platforms which report the occlusion unexpose the covered windows
+    return isVisible() && !isMinimized() && windowHandle() && windowHandle()->isExposed();
+}
+
+void VideoForm::updateVideoVisible()
+{
+    if (isVideoShown()) {
+        m_videoHiddenTimer->stop();
+        setVideoVisible(true);
+    } else if (m_videoVisible && !m_videoHiddenTimer->isActive()) {
+        m_videoHiddenTimer->start();
+    }
+}
+
+void VideoForm::setVideoVisible(bool visible)
+{
+    if (m_videoVisible == visible) {
+        return;
+    }
+    m_videoVisible = visible;
+    auto device = qsc::IDeviceManage::getInstance().getDevice(m_serial);
+    if (device) {
+        device->setVideoVisible(visible);
+    }
+    if (visible && !m_hiddenFrame.isNull()) {
+        // until the key frame requested by the device arrives
+        updateRender(m_hiddenFrame);
+        m_hiddenFrame = qsc::VideoFrame();
+    }
+}
+
+int VideoForm::downscaleFactor(const QSize &frameSize)
+{
+    if (!m_videoWidget || m_videoWidget->isHidden()) {
+        return 1;
+    }
+    return FrameDownscaler::scaleFactor(frameSize, m_videoWidget->size() * m_videoWidget->devicePixelRatioF());
+}
+
+void VideoForm::onFrameDownscaled()
+{
+    QByteArray planes;
+    QSize size;
+    qint64 decodedTimeUs = 0;
+    if (!m_downscaler || !m_downscaler->takeFrame(planes, size, decodedTimeUs)) {
+        return;
+    }
+    // the window may have grown meanwhile, the next frame is uploaded in full
+    if (downscaleFactor(m_yuvWidget->frameSize()) <= 1) {
+        return;
+    }
+    m_yuvWidget->presentScaledFrame(size, planes, decodedTimeUs);
+}
+
 void VideoForm::updateFPS(quint32 fps)
 {
     //qDebug() << "FPS:" << fps;
     if (!m_fpsLabel) {
         return;
     }
-    m_fpsLabel->setText(QString("FPS:%1").arg(fps));
+    QString text = QString("FPS:%1").arg(fps);
+    if (m_videoWidget) {
+        // upload bandwidth saved by the unchanged tiles
+        quint64 saved = m_yuvWidget->uploadBytesSavedPerSecond();
+        if (saved > 0) {
+            text += QString(" Saved:%1KB/s").arg(saved / 1024);
+        }
+        // decode to present latency over the last second, and the frames
+        // replaced by a newer one before being shown since the last update
+        const PresentStats &stats = m_yuvWidget->presentStats();
+        if (stats.averageLatencyUs > 0) {
+            text += QString(" Latency:%1ms(max %2)").arg(stats.averageLatencyUs / 1000.0, 0, 'f', 1).arg(stats.maxLatencyUs / 1000.0, 0, 'f', 1);
+        }
+        if (stats.framesNotPresented > m_framesNotPresented) {
+            text += QString(" Unshown:%1").arg(stats.framesNotPresented - m_framesNotPresented);
+        }
+        m_framesNotPresented = stats.framesNotPresented;
+    }
+    m_fpsLabel->setText(text);
 }
 
 void VideoForm::grabCursor(bool grab)
@@ -541,11 +673,6 @@ void VideoForm::grabCursor(bool grab)
     MouseTap::getInstance()->enableMouseEventTap(rc, grab);
 }
 
-void VideoForm::onFrame(int width, int height, uint8_t *dataY, uint8_t *dataU, uint8_t *dataV, int linesizeY, int linesizeU, int linesizeV)
-{
-    updateRender(width, height, dataY, dataU, dataV, linesizeY, linesizeU, linesizeV);
-}
-
 void VideoForm::staysOnTop(bool top)
 {
     bool needShow = false;
@@ -592,7 +719,7 @@ void VideoForm::mousePressEvent(QMouseEvent *event)
         }
         QPointF mappedPos = m_videoWidget->mapFrom(this, localPos.toPoint());
         QMouseEvent newEvent(event->type(), mappedPos, globalPos, event->button(), event->buttons(), event->modifiers());
-        emit device->mouseEvent(&newEvent, m_videoWidget->frameSize(), m_videoWidget->size());
+        emit device->mouseEvent(&newEvent, m_yuvWidget->frameSize(), m_videoWidget->size());
 
         // debug keymap pos
         if (event->button() == Qt::LeftButton) {
@@ -638,7 +765,7 @@ void VideoForm::mouseReleaseEvent(QMouseEvent *event)
             local.setY(m_videoWidget->height());
         }
         QMouseEvent newEvent(event->type(), local, globalPos, event->button(), event->buttons(), event->modifiers());
-        emit device->mouseEvent(&newEvent, m_videoWidget->frameSize(), m_videoWidget->size());
+        emit device->mouseEvent(&newEvent, m_yuvWidget->frameSize(), m_videoWidget->size());
     } else {
         m_dragPosition = QPoint(0, 0);
     }
@@ -660,7 +787,7 @@ void VideoForm::mouseMoveEvent(QMouseEvent *event)
         }
         QPointF mappedPos = m_videoWidget->mapFrom(this, localPos.toPoint());
         QMouseEvent newEvent(event->type(), mappedPos, globalPos, event->button(), event->buttons(), event->modifiers());
-        emit device->mouseEvent(&newEvent, m_videoWidget->frameSize(), m_videoWidget->size());
+        emit device->mouseEvent(&newEvent, m_yuvWidget->frameSize(), m_videoWidget->size());
     } else if (!m_dragPosition.isNull()) {
         if (event->buttons() & Qt::LeftButton) {
             move(globalPos.toPoint() - m_dragPosition);
@@ -695,7 +822,7 @@ void VideoForm::mouseDoubleClickEvent(QMouseEvent *event)
 #endif
         QPointF mappedPos = m_videoWidget->mapFrom(this, localPos.toPoint());
         QMouseEvent newEvent(event->type(), mappedPos, globalPos, event->button(), event->buttons(), event->modifiers());
-        emit device->mouseEvent(&newEvent, m_videoWidget->frameSize(), m_videoWidget->size());
+        emit device->mouseEvent(&newEvent, m_yuvWidget->frameSize(), m_videoWidget->size());
     }
 }
 
@@ -721,7 +848,7 @@ void VideoForm::wheelEvent(QWheelEvent *event)
             pos, event->globalPosF(), event->pixelDelta(), event->angleDelta(), event->delta(), event->orientation(),
             event->buttons(), event->modifiers(), event->phase(), event->source(), event->inverted());
 #endif
-        emit device->wheelEvent(&wheelEvent, m_videoWidget->frameSize(), m_videoWidget->size());
+        emit device->wheelEvent(&wheelEvent, m_yuvWidget->frameSize(), m_videoWidget->size());
     }
 }
 
@@ -735,7 +862,7 @@ void VideoForm::keyPressEvent(QKeyEvent *event)
         switchFullScreen();
     }
 
-    emit device->keyEvent(event, m_videoWidget->frameSize(), m_videoWidget->size());
+    emit device->keyEvent(event, m_yuvWidget->frameSize(), m_videoWidget->size());
 }
 
 void VideoForm::keyReleaseEvent(QKeyEvent *event)
@@ -744,7 +871,7 @@ void VideoForm::keyReleaseEvent(QKeyEvent *event)
     if (!device) {
         return;
     }
-    emit device->keyEvent(event, m_videoWidget->frameSize(), m_videoWidget->size());
+    emit device->keyEvent(event, m_yuvWidget->frameSize(), m_videoWidget->size());
 }
 
 void VideoForm::paintEvent(QPaintEvent *paint)
@@ -768,6 +895,33 @@ void VideoForm::showEvent(QShowEvent *event)
             showToolForm(this->show_toolbar);
         });
     }
+    // the native window exists once shown, watch its exposure
+    if (windowHandle()) {
+        windowHandle()->installEventFilter(this);
+    }
+    updateVideoVisible();
+}
+
+void VideoForm::hideEvent(QHideEvent *event)
+{
+    Q_UNUSED(event)
+    updateVideoVisible();
+}
+
+void VideoForm::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::WindowStateChange) {
+        updateVideoVisible();
+    }
+    QWidget::changeEvent(event);
+}
+
+bool VideoForm::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == windowHandle() && event->type() == QEvent::Expose) {
+        updateVideoVisible();
+    }
+    return QWidget::eventFilter(watched, event);
 }
 
 void VideoForm::resizeEvent(QResizeEvent *event)
@@ -857,10 +1011,28 @@ void VideoForm::contextMenuEvent(QContextMenuEvent *event)
 
     QMenu menu(this);
     QAction *downloadAction = menu.addAction(tr("Download File"));
+    QAction *mipmapAction = menu.addAction(tr("High Quality Scaling"));
+    mipmapAction->setCheckable(true);
+    mipmapAction->setChecked(m_yuvWidget->mipmap());
+    QAction *recordAction = menu.addAction(device->isRecording() ? tr("Stop Recording") : tr("Start Recording"));
+    QAction *replayAction = Q_NULLPTR;
+    if (Config::getInstance().getReplayDuration() > 0) {
+        replayAction = menu.addAction(tr("Save Replay"));
+    }
     
     QAction *selectedAction = menu.exec(event->globalPos());
     
-    if (selectedAction == downloadAction) {
+    if (selectedAction == mipmapAction) {
+        m_yuvWidget->setMipmap(mipmapAction->isChecked());
+    } else if (selectedAction == recordAction) {
+        if (device->isRecording()) {
+            device->stopRecording();
+        } else {
+            device->startRecording();
+        }
+    } else if (replayAction && selectedAction == replayAction) {
+        device->saveReplay();
+    } else if (selectedAction == downloadAction) {
         // 弹出对话框让用户输入设备文件路径
         bool ok;
         QString devicePath = QInputDialog::getText(this, 
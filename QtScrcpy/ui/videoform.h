@@ -13,8 +13,10 @@ namespace Ui
 
 class ToolForm;
 class FileHandler;
-class QYUVOpenGLWidget;
+class IYUVWidget;
+class FrameDownscaler;
 class QLabel;
+class QTimer;
 class VideoForm : public QWidget, public qsc::DeviceObserver
 {
     Q_OBJECT
@@ -24,7 +26,7 @@ public:
 
     void staysOnTop(bool top = true);
     void updateShowSize(const QSize &newSize);
-    void updateRender(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV);
+    void updateRender(const qsc::VideoFrame &frame);
     void setSerial(const QString& serial);
     QRect getGrabCursorRect();
     const QSize &frameSize();
@@ -35,8 +37,13 @@ public:
     bool isHost();
 
 private:
-    void onFrame(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV,
-                 int linesizeY, int linesizeU, int linesizeV) override;
+    void onVideoFrame(const qsc::VideoFrame &frame) override;
+    bool isVideoShown();
+    void updateVideoVisible();
+    void setVideoVisible(bool visible);
+    void scheduleShowSize(const QSize &newSize);
+    int downscaleFactor(const QSize &frameSize);
+    void onFrameDownscaled();
     void updateFPS(quint32 fps) override;
     void grabCursor(bool grab) override;
 
@@ -60,6 +67,9 @@ protected:
 
     void paintEvent(QPaintEvent *) override;
     void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
     void closeEvent(QCloseEvent *event) override;
 
@@ -74,11 +84,26 @@ private:
     Ui::videoForm *ui;
     QPointer<ToolForm> m_toolForm;
     QPointer<QWidget> m_loadingWidget;
-    QPointer<QYUVOpenGLWidget> m_videoWidget;
+    QPointer<QWidget> m_videoWidget;
+    // m_videoWidget, OpenGL or QPainter (UseDesktopOpenGL=3)
+    IYUVWidget *m_yuvWidget = Q_NULLPTR;
     QPointer<QLabel> m_fpsLabel;
+    // downscale on a worker thread when the window is much smaller than the stream
+    QPointer<FrameDownscaler> m_downscaler;
 
     //inside member
     QSize m_frameSize;
+    // frame size waiting for the window relayout, see scheduleShowSize()
+    QSize m_pendingShowSize;
+    bool m_showSizePending = false;
+    // frames not presented, at the previous updateFPS()
+    quint64 m_framesNotPresented = 0;
+    // 窗口隐藏、最小化或被遮挡时只解码关键帧，且不上传纹理
+    bool m_videoVisible = true;
+    // 隐藏时收到的最后一帧，恢复显示时立即显示
+    qsc::VideoFrame m_hiddenFrame;
+    // 短暂的隐藏（例如切换全屏）不切换解码模式
+    QPointer<QTimer> m_videoHiddenTimer;
     QSize m_normalSize;
     QPoint m_dragPosition;
     float m_widthHeightRatio = 0.5f;
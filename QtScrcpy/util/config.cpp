@@ -35,6 +35,45 @@
 #define COMMON_RENDER_EXPIRED_FRAMES_KEY "RenderExpiredFrames"
 #define COMMON_RENDER_EXPIRED_FRAMES_DEF 0
 
+#define COMMON_DECODER_THREAD_MODE_KEY "DecoderThreadMode"
+#define COMMON_DECODER_THREAD_MODE_DEF 0
+
+#define COMMON_DECODER_THREADS_KEY "DecoderThreads"
+#define COMMON_DECODER_THREADS_DEF 0
+
+#define COMMON_RECORD_SEGMENTED_KEY "RecordSegmented"
+#define COMMON_RECORD_SEGMENTED_DEF 0
+
+#define COMMON_RECORD_SEGMENT_DURATION_KEY "RecordSegmentDuration"
+#define COMMON_RECORD_SEGMENT_DURATION_DEF 0
+
+#define COMMON_RECORD_SEGMENT_SIZE_KEY "RecordSegmentSize"
+#define COMMON_RECORD_SEGMENT_SIZE_DEF 0
+
+#define COMMON_REPLAY_DURATION_KEY "ReplayDuration"
+#define COMMON_REPLAY_DURATION_DEF 0
+
+#define COMMON_REPLAY_SIZE_KEY "ReplaySize"
+#define COMMON_REPLAY_SIZE_DEF 64
+
+#define COMMON_RECORD_QUEUE_SIZE_KEY "RecordQueueSize"
+#define COMMON_RECORD_QUEUE_SIZE_DEF 0
+
+#define COMMON_RECORD_QUEUE_POLICY_KEY "RecordQueuePolicy"
+#define COMMON_RECORD_QUEUE_POLICY_DEF 0
+
+#define COMMON_MIPMAP_KEY "Mipmap"
+#define COMMON_MIPMAP_DEF 0
+
+#define COMMON_DEVICE_WALL_KEY "DeviceWall"
+#define COMMON_DEVICE_WALL_DEF 0
+
+#define COMMON_SCREENSHOT_FORMAT_KEY "ScreenshotFormat"
+#define COMMON_SCREENSHOT_FORMAT_DEF "png"
+
+#define COMMON_SCREENSHOT_QUALITY_KEY "ScreenshotQuality"
+#define COMMON_SCREENSHOT_QUALITY_DEF 90
+
 #define COMMON_ADB_PATH_KEY "AdbPath"
 #define COMMON_ADB_PATH_DEF ""
 
@@ -301,6 +340,123 @@ int Config::getRenderExpiredFrames()
     return renderExpiredFrames;
 }
 
+int Config::getDecoderThreadMode()
+{
+    int decoderThreadMode = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    decoderThreadMode = m_settings->value(COMMON_DECODER_THREAD_MODE_KEY, COMMON_DECODER_THREAD_MODE_DEF).toInt();
+    m_settings->endGroup();
+    return decoderThreadMode;
+}
+
+int Config::getDecoderThreads()
+{
+    int decoderThreads = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    decoderThreads = m_settings->value(COMMON_DECODER_THREADS_KEY, COMMON_DECODER_THREADS_DEF).toInt();
+    m_settings->endGroup();
+    return decoderThreads;
+}
+
+int Config::getRecordSegmented()
+{
+    int recordSegmented = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    recordSegmented = m_settings->value(COMMON_RECORD_SEGMENTED_KEY, COMMON_RECORD_SEGMENTED_DEF).toInt();
+    m_settings->endGroup();
+    return recordSegmented;
+}
+
+int Config::getRecordSegmentDuration()
+{
+    int recordSegmentDuration = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    recordSegmentDuration = m_settings->value(COMMON_RECORD_SEGMENT_DURATION_KEY, COMMON_RECORD_SEGMENT_DURATION_DEF).toInt();
+    m_settings->endGroup();
+    return recordSegmentDuration;
+}
+
+int Config::getRecordSegmentSize()
+{
+    int recordSegmentSize = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    recordSegmentSize = m_settings->value(COMMON_RECORD_SEGMENT_SIZE_KEY, COMMON_RECORD_SEGMENT_SIZE_DEF).toInt();
+    m_settings->endGroup();
+    return recordSegmentSize;
+}
+
+int Config::getReplayDuration()
+{
+    int replayDuration = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    replayDuration = m_settings->value(COMMON_REPLAY_DURATION_KEY, COMMON_REPLAY_DURATION_DEF).toInt();
+    m_settings->endGroup();
+    return replayDuration;
+}
+
+int Config::getReplaySize()
+{
+    int replaySize = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    replaySize = m_settings->value(COMMON_REPLAY_SIZE_KEY, COMMON_REPLAY_SIZE_DEF).toInt();
+    m_settings->endGroup();
+    return replaySize;
+}
+
+int Config::getRecordQueueSize()
+{
+    int recordQueueSize = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    recordQueueSize = m_settings->value(COMMON_RECORD_QUEUE_SIZE_KEY, COMMON_RECORD_QUEUE_SIZE_DEF).toInt();
+    m_settings->endGroup();
+    return recordQueueSize;
+}
+
+int Config::getRecordQueuePolicy()
+{
+    int recordQueuePolicy = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    recordQueuePolicy = m_settings->value(COMMON_RECORD_QUEUE_POLICY_KEY, COMMON_RECORD_QUEUE_POLICY_DEF).toInt();
+    m_settings->endGroup();
+    return recordQueuePolicy;
+}
+
+int Config::getMipmap()
+{
+    int mipmap = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    mipmap = m_settings->value(COMMON_MIPMAP_KEY, COMMON_MIPMAP_DEF).toInt();
+    m_settings->endGroup();
+    return mipmap;
+}
+
+int Config::getDeviceWall()
+{
+    int deviceWall = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    deviceWall = m_settings->value(COMMON_DEVICE_WALL_KEY, COMMON_DEVICE_WALL_DEF).toInt();
+    m_settings->endGroup();
+    return deviceWall;
+}
+
+QString Config::getScreenshotFormat()
+{
+    QString screenshotFormat;
+    m_settings->beginGroup(GROUP_COMMON);
+    screenshotFormat = m_settings->value(COMMON_SCREENSHOT_FORMAT_KEY, COMMON_SCREENSHOT_FORMAT_DEF).toString();
+    m_settings->endGroup();
+    return screenshotFormat;
+}
+
+int Config::getScreenshotQuality()
+{
+    int screenshotQuality = 90;
+    m_settings->beginGroup(GROUP_COMMON);
+    screenshotQuality = m_settings->value(COMMON_SCREENSHOT_QUALITY_KEY, COMMON_SCREENSHOT_QUALITY_DEF).toInt();
+    m_settings->endGroup();
+    return screenshotQuality;
+}
+
 QString Config::getPushFilePath()
 {
     QString pushFile;
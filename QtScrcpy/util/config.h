@@ -40,6 +40,19 @@ public:
     int getDesktopOpenGL();
     int getSkin();
     int getRenderExpiredFrames();
+    int getDecoderThreadMode();
+    int getDecoderThreads();
+    int getRecordSegmented();
+    int getRecordSegmentDuration();
+    int getRecordSegmentSize();
+    int getReplayDuration();
+    int getReplaySize();
+    int getRecordQueueSize();
+    int getRecordQueuePolicy();
+    int getMipmap();
+    int getDeviceWall();
+    QString getScreenshotFormat();
+    int getScreenshotQuality();
     QString getPushFilePath();
     QString getServerPath();
     QString getAdbPath();